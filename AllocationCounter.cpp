@@ -0,0 +1,137 @@
+#include "AllocationCounter.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <malloc.h> //for _aligned_malloc
+#endif
+
+//(plain integers, so counting can't itself allocate)
+static thread_local uint64_t allocation_count = 0;
+static thread_local uint64_t allocated_bytes = 0;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" //(gcc sees free() in a replacement operator delete and thinks it's a mismatch)
+#endif
+
+//every replaceable form of operator new is replaced (plain, array, nothrow, and over-aligned), so every allocation is counted here:
+static void *counted_malloc(size_t size) noexcept {
+	allocation_count += 1;
+	allocated_bytes += size;
+	return std::malloc(size ? size : 1);
+}
+static void *counted_aligned_malloc(size_t size, std::align_val_t align) noexcept {
+	allocation_count += 1;
+	allocated_bytes += size;
+	size_t alignment = size_t(align);
+	#ifdef _WIN32
+	return _aligned_malloc(size ? size : 1, alignment);
+	#else
+	//(aligned_alloc wants a size that is a multiple of the alignment)
+	return std::aligned_alloc(alignment, (std::max< size_t >(size, 1) + alignment - 1) / alignment * alignment);
+	#endif
+}
+static void aligned_free(void *ptr) noexcept {
+	#ifdef _WIN32
+	_aligned_free(ptr);
+	#else
+	std::free(ptr);
+	#endif
+}
+
+void *operator new(size_t size) {
+	if (void *ptr = counted_malloc(size)) return ptr;
+	throw std::bad_alloc();
+}
+void *operator new[](size_t size) {
+	if (void *ptr = counted_malloc(size)) return ptr;
+	throw std::bad_alloc();
+}
+void *operator new(size_t size, std::nothrow_t const &) noexcept {
+	return counted_malloc(size);
+}
+void *operator new[](size_t size, std::nothrow_t const &) noexcept {
+	return counted_malloc(size);
+}
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void *ptr) noexcept {
+	std::free(ptr);
+}
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+void operator delete(void *ptr, std::nothrow_t const &) noexcept {
+	std::free(ptr);
+}
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept {
+	std::free(ptr);
+}
+
+//(over-aligned types -- alignas bigger than the default new alignment):
+void *operator new(size_t size, std::align_val_t align) {
+	if (void *ptr = counted_aligned_malloc(size, align)) return ptr;
+	throw std::bad_alloc();
+}
+void *operator new[](size_t size, std::align_val_t align) {
+	if (void *ptr = counted_aligned_malloc(size, align)) return ptr;
+	throw std::bad_alloc();
+}
+void *operator new(size_t size, std::align_val_t align, std::nothrow_t const &) noexcept {
+	return counted_aligned_malloc(size, align);
+}
+void *operator new[](size_t size, std::align_val_t align, std::nothrow_t const &) noexcept {
+	return counted_aligned_malloc(size, align);
+}
+void operator delete(void *ptr, std::align_val_t) noexcept {
+	aligned_free(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+	aligned_free(ptr);
+}
+void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+	aligned_free(ptr);
+}
+void operator delete[](void *ptr, size_t, std::align_val_t) noexcept {
+	aligned_free(ptr);
+}
+void operator delete(void *ptr, std::align_val_t, std::nothrow_t const &) noexcept {
+	aligned_free(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t, std::nothrow_t const &) noexcept {
+	aligned_free(ptr);
+}
+
+AllocationCounter::AllocationCounter() : start_allocations(allocation_count), start_bytes(allocated_bytes) {
+}
+
+uint64_t AllocationCounter::allocations() const {
+	return allocation_count - start_allocations;
+}
+
+uint64_t AllocationCounter::bytes() const {
+	return allocated_bytes - start_bytes;
+}
+
+void AllocationCounter::expect_none(char const *what) const {
+	uint64_t count = allocations();
+	if (count != 0) {
+		throw std::runtime_error(std::string(what) + " allocated " + std::to_string(count) + " times (" + std::to_string(bytes()) + " bytes), but should not allocate at all.");
+	}
+}
+
+uint64_t AllocationCounter::thread_allocations() {
+	return allocation_count;
+}
+
+uint64_t AllocationCounter::thread_bytes() {
+	return allocated_bytes;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+//Heap allocation counting, for checking that code meant to be allocation-free stays that way
+// (e.g., a server tick or a client snapshot decode once warmed up -- see sim-bench.cpp).
+//
+//Counts come from the replacement global operator new (every form, including nothrow and over-aligned) in AllocationCounter.cpp,
+// so only programs that link it can use this -- and direct malloc() calls are not counted.
+// Counts are per thread, so other threads' allocations don't show up in a check.
+struct AllocationCounter {
+	//start counting now:
+	AllocationCounter();
+
+	//allocations (and bytes requested) by this thread since construction:
+	uint64_t allocations() const;
+	uint64_t bytes() const;
+
+	//throws (naming 'what') if this thread has allocated since construction:
+	void expect_none(char const *what) const;
+
+	//totals for this thread since it started:
+	static uint64_t thread_allocations();
+	static uint64_t thread_bytes();
+
+	uint64_t start_allocations;
+	uint64_t start_bytes;
+};
@@ -0,0 +1,495 @@
+#include "Arena.hpp"
+
+#include "BitPack.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+Arena::Arena(uint64_t seed, uint32_t serve_, uint32_t pad_count_) : serve(std::clamp(serve_, 1u, MaxBalls)), pad_count(std::min(pad_count_, MaxPads)), random(seed) {
+	balls.reserve(MaxBalls);
+	pads.reserve(MaxPads);
+	grid.start.assign(CellsX * CellsY + 1, 0);
+	grid.cell_of.reserve(MaxBalls);
+	grid.sorted.reserve(MaxBalls);
+	pad_taken.reserve(MaxPads);
+
+	while (balls.size() < serve) serve_ball();
+	pad_cooldown = PadCooldown;
+}
+
+//------------ simulation ------------
+
+void Arena::serve_ball() {
+	//(direction as Game::start_round)
+	glm::vec2 dir = glm::vec2(0.0f);
+	while (dir.x == 0.0f && (std::abs(dir.y) == 1.0f || dir.y == 0.0f)) {
+		dir.x = random.uniform(-1.0f, 1.0f);
+		dir.y = random.uniform(-1.0f, 1.0f);
+	}
+	dir = dir / std::sqrt(dir.x * dir.x + dir.y * dir.y);
+
+	//(from anywhere on the center line -- served from one spot, a crowd of balls would all start out on top of each other)
+	Ball ball;
+	ball.position = glm::vec2(0.0f, random.uniform(-0.8f, 0.8f) * Game::ArenaMax.y);
+	ball.velocity = dir * Game::BallSpeed;
+	balls.emplace_back(ball);
+}
+
+void Arena::spawn_pad() {
+	//(as Game::update)
+	Pad pad;
+	float x = random.uniform(-0.8f, 0.8f);
+	float y = random.uniform(-0.8f, 0.8f);
+	pad.position = glm::vec2(Game::ArenaMax.x * x, Game::ArenaMax.y * y);
+	pad.kind = uint8_t(random.below(PadKinds));
+	pads.emplace_back(pad);
+}
+
+void Arena::update(float elapsed) {
+	if (pads.size() < pad_count) {
+		pad_cooldown -= elapsed;
+		if (pad_cooldown < 0.0f) {
+			spawn_pad();
+			pad_cooldown = PadCooldown;
+		}
+	}
+
+	for (auto &p : players) {
+		if (p.frozen()) continue;
+		Game::move_player(p, elapsed);
+		p.controls.up.downs = 0;
+		p.controls.down.downs = 0;
+	}
+	effect_timers.advance([this](uint8_t index, PowerUp::Type type) {
+		assert(index < players.size());
+		Game::expire_power_up(players[index], index, type, &effect_timers, tick);
+	});
+
+	move_balls(elapsed);
+	while (balls.size() < serve) serve_ball();
+
+	grid.build(&balls);
+	collide_balls();
+	collect_pads();
+	hit_paddles();
+}
+
+void Arena::move_balls(float elapsed) {
+	float const Top = Game::ArenaMax.y - Game::WallThickness - Game::BallRadius;
+	float const Bottom = Game::ArenaMin.y + Game::WallThickness + Game::BallRadius;
+	float const Right = Game::ArenaMax.x - Game::WallThickness - Game::BallRadius;
+	float const Left = Game::ArenaMin.x + Game::WallThickness + Game::BallRadius;
+
+	//survivors are packed down in place (keeping their order):
+	uint32_t kept = 0;
+	for (uint32_t b = 0; b < balls.size(); ++b) {
+		Ball ball = balls[b];
+		ball.position += ball.velocity * elapsed;
+
+		//walls (a tick moves a ball far less than the arena's height, so one bounce is enough):
+		if (ball.position.y > Top) {
+			ball.position.y = Top - (ball.position.y - Top);
+			ball.velocity.y = -std::abs(ball.velocity.y);
+		} else if (ball.position.y < Bottom) {
+			ball.position.y = Bottom + (Bottom - ball.position.y);
+			ball.velocity.y = std::abs(ball.velocity.y);
+		}
+
+		//goals (the left goal is players[0]'s, as in Game):
+		bool scored = false;
+		if (ball.position.x > Right || ball.position.x < Left) {
+			bool left = (ball.position.x < Left);
+			Player &receiving = players[left ? 0 : 1];
+			Player &sender = players[left ? 1 : 0];
+			uint32_t saves = receiving.powerUps.mask & Game::GoalSavingPowerUps;
+			if (saves) {
+				receiving.powerUps.remove_one(PowerUp::Type(std::countr_zero(saves)));
+				float edge = (left ? Left : Right);
+				ball.position.x = edge - (ball.position.x - edge);
+				ball.velocity.x = (left ? std::abs(ball.velocity.x) : -std::abs(ball.velocity.x));
+			} else {
+				sender.score += 1;
+				scored = true;
+			}
+		}
+
+		if (!scored) balls[kept++] = ball;
+	}
+	balls.resize(kept);
+}
+
+//the pairs of overlapping balls that are moving together bounce off each other (equal masses, so they swap velocity along the line between them):
+// (only velocities change here, so the grid -- built from positions -- stays exact for the whole pass)
+void Arena::collide_balls() {
+	float const Touch = 2.0f * Game::BallRadius;
+	//(one ball can come out of a bounce faster than either went in -- not faster than MaxBallSpeed, though)
+	auto limit_speed = [](Ball *ball) {
+		float speed2 = ball->velocity.x * ball->velocity.x + ball->velocity.y * ball->velocity.y;
+		if (speed2 > MaxBallSpeed * MaxBallSpeed) ball->velocity *= MaxBallSpeed / std::sqrt(speed2);
+	};
+
+	auto collide = [&](uint32_t a, uint32_t b) {
+		glm::vec2 d = balls[b].position - balls[a].position;
+		float dist2 = d.x * d.x + d.y * d.y;
+		if (!(dist2 < Touch * Touch) || dist2 == 0.0f) return;
+		glm::vec2 rel = balls[b].velocity - balls[a].velocity;
+		float closing = rel.x * d.x + rel.y * d.y;
+		if (closing >= 0.0f) return; //(already moving apart)
+		glm::vec2 impulse = d * (closing / dist2);
+		balls[a].velocity += impulse;
+		balls[b].velocity -= impulse;
+		limit_speed(&balls[a]);
+		limit_speed(&balls[b]);
+	};
+
+	uint32_t count = grid.count;
+	if (!broadphase) {
+		for (uint32_t a = 0; a < count; ++a) {
+			for (uint32_t b = a + 1; b < count; ++b) {
+				collide(a, b);
+			}
+		}
+		return;
+	}
+
+	for (uint32_t a = 0; a < count; ++a) {
+		//the later balls in this cell and the eight around it, which (as the balls are sorted by cell) are
+		// the rest of this row's run and all of the next row's -- already in index order, as when checking every pair:
+		uint32_t cx = cell_x(balls[a].position.x), cy = cell_y(balls[a].position.y);
+		uint32_t x0 = (cx > 0 ? cx - 1 : 0), x1 = std::min(cx + 1, CellsX - 1);
+		uint32_t end = grid.start[cy * CellsX + x1 + 1];
+		for (uint32_t b = a + 1; b < end; ++b) {
+			collide(a, b);
+		}
+		if (cy + 1 < CellsY) {
+			uint32_t next = (cy + 1) * CellsX;
+			for (uint32_t b = grid.start[next + x0]; b < grid.start[next + x1 + 1]; ++b) {
+				collide(a, b);
+			}
+		}
+	}
+}
+
+//each pad goes to the lowest-numbered ball over it:
+void Arena::collect_pads() {
+	if (pads.empty()) return;
+	glm::vec2 const Reach = Game::PowerUpPadSize + glm::vec2(Game::BallRadius);
+
+	auto over = [&](uint32_t b, Pad const &pad) {
+		glm::vec2 p = balls[b].position;
+		glm::vec2 d = p - glm::clamp(p, pad.position - Game::PowerUpPadSize, pad.position + Game::PowerUpPadSize);
+		return d.x * d.x + d.y * d.y < Game::BallRadius * Game::BallRadius;
+	};
+
+	pad_taken.assign(pads.size(), 0);
+	uint32_t count = grid.count; //(Multiball adds balls as pads are collected -- they can collect next tick)
+	for (uint32_t p = 0; p < pads.size(); ++p) {
+		Pad const &pad = pads[p];
+		uint32_t first = count;
+		if (broadphase) {
+			for (uint32_t y = cell_y(pad.position.y - Reach.y); y <= cell_y(pad.position.y + Reach.y); ++y) {
+				uint32_t row = y * CellsX;
+				uint32_t end = grid.start[row + cell_x(pad.position.x + Reach.x) + 1];
+				for (uint32_t b = grid.start[row + cell_x(pad.position.x - Reach.x)]; b < end && b < first; ++b) {
+					if (over(b, pad)) first = b;
+				}
+			}
+		} else {
+			for (uint32_t b = 0; b < count; ++b) {
+				if (over(b, pad)) {
+					first = b;
+					break;
+				}
+			}
+		}
+		if (first < count) {
+			pad_taken[p] = 1;
+			collect(first, pad.kind);
+		}
+	}
+
+	uint32_t kept = 0;
+	for (uint32_t p = 0; p < pads.size(); ++p) {
+		if (!pad_taken[p]) pads[kept++] = pads[p];
+	}
+	pads.resize(kept);
+}
+
+void Arena::collect(uint32_t b, uint8_t kind) {
+	if (kind == Multiball) {
+		//(two more balls, turned either way from this one -- by a fixed sine / cosine, as std::sin and std::cos aren't the same everywhere)
+		glm::vec2 v = balls[b].velocity;
+		for (float s : {MultiballSin, -MultiballSin}) {
+			if (balls.size() >= MaxBalls) break;
+			Ball ball;
+			ball.position = balls[b].position;
+			ball.velocity = glm::vec2(MultiballCos * v.x - s * v.y, s * v.x + MultiballCos * v.y);
+			balls.emplace_back(ball);
+		}
+		return;
+	}
+
+	PowerUp::Type type = PowerUp::Type(kind);
+	PowerUpEffect const &effect = Game::PowerUpEffects[type];
+	Ball &ball = balls[b];
+	if (effect.target == PowerUpEffect::Ball) {
+		float speed = std::sqrt(ball.velocity.x * ball.velocity.x + ball.velocity.y * ball.velocity.y);
+		if (speed * effect.ball_speed_factor <= MaxBallSpeed) ball.velocity *= effect.ball_speed_factor;
+		return;
+	}
+	//(as Game::collect_power_up -- the receiver is the one the ball is heading for)
+	uint8_t receiving = (ball.velocity.x < 0.0f ? 0 : 1);
+	uint8_t index = (effect.target == PowerUpEffect::Receiver ? receiving : 1 - receiving);
+	Game::gain_power_up(players[index], index, type, &effect_timers, tick);
+}
+
+//balls touching a paddle are pushed off it, and bounce if they were moving into it:
+void Arena::hit_paddles() {
+	glm::vec2 const Half = glm::vec2(Game::PlayerWidth, Game::PlayerHeight);
+	glm::vec2 const Reach = Half + glm::vec2(Game::BallRadius);
+	float const R = Game::BallRadius;
+
+	for (uint32_t i = 0; i < players.size(); ++i) {
+		glm::vec2 center = glm::vec2(i == 0 ? -Game::PlayerXPos : Game::PlayerXPos, players[i].position);
+
+		auto hit = [&](uint32_t b) {
+			Ball &ball = balls[b];
+			glm::vec2 q = ball.position - center;
+			glm::vec2 d = q - glm::clamp(q, -Half, Half);
+			if (!(d.x * d.x + d.y * d.y < R * R)) return;
+			if (std::abs(q.y) <= Half.y) {
+				//(face)
+				float side = (q.x >= 0.0f ? 1.0f : -1.0f);
+				ball.position.x = center.x + side * (Half.x + R);
+				if (ball.velocity.x * side < 0.0f) ball.velocity.x = -ball.velocity.x;
+			} else {
+				//(end)
+				float side = (q.y >= 0.0f ? 1.0f : -1.0f);
+				ball.position.y = center.y + side * (Half.y + R);
+				if (ball.velocity.y * side < 0.0f) ball.velocity.y = -ball.velocity.y;
+			}
+		};
+
+		//(each ball is on its own here, so the order doesn't matter)
+		if (broadphase) {
+			for (uint32_t y = cell_y(center.y - Reach.y); y <= cell_y(center.y + Reach.y); ++y) {
+				uint32_t row = y * CellsX;
+				uint32_t end = grid.start[row + cell_x(center.x + Reach.x) + 1];
+				for (uint32_t b = grid.start[row + cell_x(center.x - Reach.x)]; b < end; ++b) {
+					hit(b);
+				}
+			}
+		} else {
+			for (uint32_t b = 0; b < grid.count; ++b) {
+				hit(b);
+			}
+		}
+	}
+}
+
+//------------ spatial hash ------------
+
+uint32_t Arena::cell_x(float x) {
+	float c = (x - Game::ArenaMin.x) * (1.0f / CellSize);
+	if (!(c > 0.0f)) return 0; //(also catches NaN)
+	return std::min(uint32_t(c), CellsX - 1);
+}
+
+uint32_t Arena::cell_y(float y) {
+	float c = (y - Game::ArenaMin.y) * (1.0f / CellSize);
+	if (!(c > 0.0f)) return 0;
+	return std::min(uint32_t(c), CellsY - 1);
+}
+
+void Arena::Grid::build(std::vector< Ball > *balls_) {
+	assert(balls_);
+	std::vector< Ball > &balls = *balls_;
+	count = uint32_t(balls.size());
+	cell_of.resize(count);
+	std::fill(start.begin(), start.end(), 0);
+
+	//counting sort by cell:
+	for (uint32_t b = 0; b < count; ++b) {
+		uint32_t c = cell_y(balls[b].position.y) * CellsX + cell_x(balls[b].position.x);
+		cell_of[b] = c;
+		start[c + 1] += 1;
+	}
+	for (uint32_t c = 0; c + 1 < start.size(); ++c) {
+		start[c + 1] += start[c];
+	}
+	//(place each ball, using start[c] as cell c's cursor -- afterward start[c] has moved to where cell c+1 begins)
+	sorted.resize(count);
+	for (uint32_t b = 0; b < count; ++b) {
+		sorted[start[cell_of[b]]++] = balls[b];
+	}
+	for (uint32_t c = uint32_t(start.size()) - 1; c > 0; --c) {
+		start[c] = start[c - 1];
+	}
+	start[0] = 0;
+
+	//(both keep their capacity, so this never allocates)
+	balls.swap(sorted);
+}
+
+//------------ hash ------------
+
+uint64_t Arena::hash() const {
+	uint64_t h = 0xcbf29ce484222325ull;
+	auto add = [&](auto const &val) {
+		uint8_t bytes[sizeof(val)];
+		std::memcpy(bytes, &val, sizeof(val));
+		for (uint8_t b : bytes) {
+			h = (h ^ b) * 0x100000001b3ull;
+		}
+	};
+
+	for (auto const &p : players) {
+		add(p.controls.up.downs);
+		add(uint8_t(p.controls.up.pressed));
+		add(p.controls.down.downs);
+		add(uint8_t(p.controls.down.pressed));
+		add(p.position);
+		add(p.velocity);
+		add(p.score);
+		add(p.powerUps.mask);
+		add(p.powerUps.counts);
+	}
+	add(uint32_t(balls.size()));
+	for (auto const &ball : balls) {
+		add(ball.position.x);
+		add(ball.position.y);
+		add(ball.velocity.x);
+		add(ball.velocity.y);
+	}
+	add(uint32_t(pads.size()));
+	for (auto const &pad : pads) {
+		add(pad.position.x);
+		add(pad.position.y);
+		add(pad.kind);
+	}
+	add(pad_cooldown);
+	add(effect_timers.now);
+	add(uint32_t(effect_timers.count));
+	effect_timers.for_each([&](EffectTimers::Timer const &timer) {
+		add(timer.expires);
+		add(timer.player);
+		add(timer.type);
+	});
+	add(random.state);
+	return h;
+}
+
+//------------ network ------------
+
+//points as [exp-Golomb cells skipped][in-cell x, y], in wire-cell order (quantized positions decide the cell, so the decoder agrees):
+// 'extra(i, writer)' writes anything else that goes with point i.
+template< typename Items, typename Extra >
+static void write_points(BitWriter &writer, Items const &items, std::vector< uint32_t > &cells, std::vector< uint32_t > &start, std::vector< uint32_t > &order, Extra &&extra) {
+	constexpr uint32_t WireCellsX = (Game::StepsX >> Arena::WireCellBits) + 1;
+	constexpr uint32_t WireCellsY = (Game::StepsY >> Arena::WireCellBits) + 1;
+
+	uint32_t count = uint32_t(items.size());
+	writer.write_varint(count);
+
+	//quantize, and counting sort by cell:
+	cells.resize(2 * size_t(count));
+	start.assign(WireCellsX * WireCellsY + 1, 0);
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t qx = Game::quantize(items[i].position.x, Game::ArenaMin.x, Game::ArenaMax.x, Game::StepsX);
+		uint32_t qy = Game::quantize(items[i].position.y, Game::ArenaMin.y, Game::ArenaMax.y, Game::StepsY);
+		cells[2 * i + 0] = qx;
+		cells[2 * i + 1] = qy;
+		start[(qy >> Arena::WireCellBits) * WireCellsX + (qx >> Arena::WireCellBits) + 1] += 1;
+	}
+	for (uint32_t c = 0; c + 1 < start.size(); ++c) {
+		start[c + 1] += start[c];
+	}
+	order.resize(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t c = (cells[2 * i + 1] >> Arena::WireCellBits) * WireCellsX + (cells[2 * i + 0] >> Arena::WireCellBits);
+		order[start[c]++] = i;
+	}
+
+	uint32_t prev = 0;
+	for (uint32_t i : order) {
+		uint32_t qx = cells[2 * i + 0], qy = cells[2 * i + 1];
+		uint32_t c = (qy >> Arena::WireCellBits) * WireCellsX + (qx >> Arena::WireCellBits);
+		writer.write_expgolomb(c - prev);
+		prev = c;
+		writer.write(qx & (Arena::WireCellSteps - 1), Arena::WireCellBits);
+		writer.write(qy & (Arena::WireCellSteps - 1), Arena::WireCellBits);
+		extra(i);
+	}
+}
+
+//read points written by write_points, calling 'got(position)' for each (which reads its extras):
+template< typename Got >
+static void read_points(BitReader &reader, uint32_t max_count, char const *what, Got &&got) {
+	constexpr uint32_t WireCellsX = (Game::StepsX >> Arena::WireCellBits) + 1;
+	constexpr uint32_t WireCellsY = (Game::StepsY >> Arena::WireCellBits) + 1;
+
+	uint32_t count = reader.read_varint();
+	if (count > max_count) throw std::runtime_error("Arena state with " + std::to_string(count) + " " + what + ".");
+	uint32_t c = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		c += reader.read_expgolomb();
+		if (c >= WireCellsX * WireCellsY) throw std::runtime_error("Arena state with a point past the last cell.");
+		uint32_t qx = (c % WireCellsX) * Arena::WireCellSteps + reader.read(Arena::WireCellBits);
+		uint32_t qy = (c / WireCellsX) * Arena::WireCellSteps + reader.read(Arena::WireCellBits);
+		got(glm::vec2(
+			Game::dequantize(qx, Game::ArenaMin.x, Game::ArenaMax.x, Game::StepsX),
+			Game::dequantize(qy, Game::ArenaMin.y, Game::ArenaMax.y, Game::StepsY)
+		));
+	}
+}
+
+void Arena::encode_state(std::vector< uint8_t > *state) {
+	assert(state);
+	BitWriter writer(*state);
+
+	for (auto const &p : players) {
+		writer.write(Game::quantize(p.position, Game::ArenaMin.y, Game::ArenaMax.y, Game::StepsY), Game::BitsY);
+		writer.write_varint(p.score);
+		writer.write(p.powerUps.mask, PowerUp::TYPE_LENGTH);
+	}
+	write_points(writer, balls, wire_cells, wire_start, wire_order, [](uint32_t) { });
+	write_points(writer, pads, wire_cells, wire_start, wire_order, [&](uint32_t i) {
+		writer.write(pads[i].kind, PadKindBits);
+	});
+}
+
+void Arena::decode_state(std::vector< uint8_t > const &state) {
+	BitReader reader(state);
+
+	for (auto &p : players) {
+		p.position = Game::dequantize(reader.read(Game::BitsY), Game::ArenaMin.y, Game::ArenaMax.y, Game::StepsY);
+		p.score = reader.read_varint();
+		//(which types are held, not how many -- as in Game's packed encoding)
+		uint32_t mask = reader.read(PowerUp::TYPE_LENGTH);
+		p.powerUps.clear();
+		for (uint32_t t = 0; t < PowerUp::TYPE_LENGTH; ++t) {
+			if (mask & (1u << t)) p.powerUps.add(PowerUp::Type(t), 1);
+		}
+	}
+
+	balls.clear();
+	read_points(reader, MaxBalls, "balls", [&](glm::vec2 position) {
+		Ball ball;
+		ball.position = position;
+		balls.emplace_back(ball);
+	});
+	pads.clear();
+	read_points(reader, MaxPads, "pads", [&](glm::vec2 position) {
+		Pad pad;
+		pad.position = position;
+		pad.kind = uint8_t(reader.read(PadKindBits));
+		if (pad.kind >= PadKinds) throw std::runtime_error("Arena state with a pad of kind " + std::to_string(pad.kind) + ".");
+		pads.emplace_back(pad);
+	});
+
+	if (!reader.finished()) throw std::runtime_error("Trailing data in arena state.");
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Game.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+//Arena mode: Game's two paddles, but with many balls and power-up pads in play at once --
+// "chaos mode" keeps lots of balls served, and Multiball pads split a ball into several.
+//
+//Collisions are found with a spatial hash: a uniform grid over Game::ArenaMin..ArenaMax. Every tick the balls are
+// counting-sorted by cell (so each cell's balls are a run of 'balls', and a row of cells is one longer run).
+// Balls only meet balls in neighboring cells, and pads and paddles only look at the cells they cover,
+// so a tick costs O(balls + pads + balls touching) instead of O(balls^2 + balls * pads).
+//Pairs are handled in the same order either way, so with 'broadphase' off (every pair checked) the results are bit-identical -- see arena-bench.
+struct Arena {
+	//'serve' balls are kept in play (one scored is served again from the center line while there are fewer); at most 'pad_count' pads at once:
+	Arena(uint64_t seed, uint32_t serve, uint32_t pad_count);
+
+	struct Ball {
+		glm::vec2 position = glm::vec2(0.0f);
+		glm::vec2 velocity = glm::vec2(0.0f);
+	};
+
+	//what a pad holds: a power-up (see Game::PowerUpEffects), or more balls:
+	inline static constexpr uint8_t Multiball = PowerUp::TYPE_LENGTH;
+	inline static constexpr uint8_t PadKinds = PowerUp::TYPE_LENGTH + 1;
+	inline static constexpr uint32_t PadKindBits = 2; //(on the wire)
+	static_assert(PadKinds <= (1u << PadKindBits), "Pad kinds must fit in PadKindBits.");
+
+	struct Pad {
+		glm::vec2 position = glm::vec2(0.0f);
+		uint8_t kind = 0;
+	};
+
+	std::array< Player, 2 > players; //[0] is the left paddle, [1] the right (as Game's players.front() / .back())
+	std::vector< Ball > balls;
+	std::vector< Pad > pads;
+
+	uint32_t serve = 1;
+	uint32_t pad_count = 0;
+	float pad_cooldown = 0.0f; //(seconds until the next pad appears, if there's room for one)
+
+	EffectTimers effect_timers; //(held power-ups running out, as in Game)
+	float tick = Game::Tick; //seconds per update() (as Game::tick -- timers count updates)
+	GameRandom random;
+
+	bool broadphase = true; //(false: check every pair instead -- much slower, same results)
+
+	void update(float elapsed);
+
+	//checksum (64-bit FNV-1a) of the whole simulation state, as Game::hash():
+	uint64_t hash() const;
+
+	//constants (sizes and speeds are Game's):
+	inline static constexpr uint32_t MaxBalls = 1024; //(about as many as fit: their area is then half the arena's)
+	inline static constexpr uint32_t MaxPads = 256;
+	//a Multiball pad turns one ball into three, the new ones turned 0.35 radians either way:
+	inline static constexpr float MultiballCos = 0.93937271f;
+	inline static constexpr float MultiballSin = 0.34289781f;
+	inline static constexpr float PadCooldown = 0.25f;
+	inline static constexpr float MaxBallSpeed = 240.0f; //(no ball goes faster, so none moves past a paddle in one tick)
+
+	//---- spatial hash ----
+
+	inline static constexpr float CellSize = 8.0f; //(at least a ball's diameter, so touching balls are always in neighboring cells)
+	inline static constexpr uint32_t CellsX = uint32_t((Game::ArenaMax.x - Game::ArenaMin.x) / CellSize) + 1;
+	inline static constexpr uint32_t CellsY = uint32_t((Game::ArenaMax.y - Game::ArenaMin.y) / CellSize) + 1;
+
+	//cell column / row of a point (clamped to the grid):
+	static uint32_t cell_x(float x);
+	static uint32_t cell_y(float y);
+
+	//the balls in each cell, as of the start of the collision pass:
+	struct Grid {
+		std::vector< uint32_t > start; //cell c (= row * CellsX + column) holds balls[start[c]] .. balls[start[c+1] - 1]
+		uint32_t count = 0; //(balls sorted -- ones added since, by Multiball, wait for the next tick)
+		//sort *balls by cell (stable -- balls in the same cell keep their order) and index them:
+		void build(std::vector< Ball > *balls);
+		std::vector< uint32_t > cell_of; //(scratch)
+		std::vector< Ball > sorted; //(scratch)
+	} grid;
+
+	//---- network ----
+
+	//packed snapshot, appended to *state (quantized like Game's packed encoding; non-const only for scratch space):
+	//  per player: [BitsY position][varint score][PowerUp::TYPE_LENGTH bits power-up mask]
+	//  [varint ball count], then each ball in wire-cell order: [exp-Golomb cells skipped since the last ball][x, y offsets within its cell]
+	//  [varint pad count], then each pad the same way, plus [PadKindBits kind]
+	//Sorted by cell, crowded balls cost only a few bits more than their in-cell offsets -- a ball costs less the more balls there are.
+	void encode_state(std::vector< uint8_t > *state);
+	//(throws on malformed payload; decoded balls have no velocity, and come in cell order rather than the server's)
+	void decode_state(std::vector< uint8_t > const &state);
+
+	//wire cells are WireCellSteps x WireCellSteps quantization steps (Game::PositionStep):
+	inline static constexpr uint32_t WireCellBits = 9;
+	inline static constexpr uint32_t WireCellSteps = 1u << WireCellBits;
+
+	//---- internals ----
+
+	void serve_ball();
+	void spawn_pad();
+	void move_balls(float elapsed);
+	void collide_balls();
+	void collect_pads();
+	void hit_paddles();
+	//ball 'b' went over a pad of 'kind':
+	void collect(uint32_t b, uint8_t kind);
+
+	//scratch (kept between ticks so steady play doesn't allocate):
+	std::vector< uint8_t > pad_taken;
+	std::vector< uint32_t > wire_cells, wire_start, wire_order;
+};
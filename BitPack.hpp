@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+#include <stdexcept>
+
+//Bit-level serialization, least significant bit first:
+// - fields take exactly as many bits as they are given (no byte alignment between fields)
+// - the byte order is fixed, so the result doesn't depend on the host's endianness
+// - varints use 8-bit groups: 7 bits of value plus a continuation bit
+// - exp-Golomb codes suit values that are usually tiny: v takes 2*floor(log2(v+1)) + 1 bits (0 is one bit, 1-2 three, 3-6 five, ...)
+
+//appends bits to the back of 'bytes':
+struct BitWriter {
+	explicit BitWriter(std::vector< uint8_t > &bytes_) : bytes(bytes_) { }
+
+	void write(uint32_t value, uint32_t bits) {
+		assert(bits <= 32);
+		assert(bits == 32 || (value >> bits) == 0);
+		while (bits > 0) {
+			if (used == 0) bytes.emplace_back(uint8_t(0));
+			uint32_t take = std::min(bits, 8 - used);
+			bytes.back() |= uint8_t((value & ((1u << take) - 1)) << used);
+			value >>= take;
+			bits -= take;
+			used = (used + take) % 8;
+		}
+	}
+
+	void write_varint(uint32_t value) {
+		while (value >= 0x80) {
+			write((value & 0x7f) | 0x80, 8);
+			value >>= 7;
+		}
+		write(value, 8);
+	}
+
+	void write_expgolomb(uint32_t value) {
+		assert(value < 0xffffffffu);
+		uint32_t v = value + 1;
+		uint32_t length = 0;
+		while ((v >> length) > 1) ++length;
+		write(0, length); //(as many zeros as bits after v's leading one)
+		//then v itself, most significant bit first:
+		for (uint32_t b = length + 1; b > 0; --b) {
+			write((v >> (b - 1)) & 1, 1);
+		}
+	}
+
+	std::vector< uint8_t > &bytes;
+	uint32_t used = 0; //bits already used in bytes.back() (0 means start a new byte)
+};
+
+//reads bits from the front of 'bytes' (throws if they run out):
+struct BitReader {
+	explicit BitReader(std::span< uint8_t const > bytes_) : bytes(bytes_) { }
+
+	uint32_t read(uint32_t bits) {
+		assert(bits <= 32);
+		if (at + bits > 8 * bytes.size()) throw std::runtime_error("Ran out of bits reading packed data.");
+		uint32_t value = 0;
+		uint32_t got = 0;
+		while (got < bits) {
+			uint32_t shift = uint32_t(at % 8);
+			uint32_t take = std::min(bits - got, 8 - shift);
+			value |= ((uint32_t(bytes[at / 8]) >> shift) & ((1u << take) - 1)) << got;
+			got += take;
+			at += take;
+		}
+		return value;
+	}
+
+	uint32_t read_varint() {
+		uint32_t value = 0;
+		for (uint32_t shift = 0; shift < 35; shift += 7) {
+			uint32_t group = read(8);
+			value |= (group & 0x7f) << shift;
+			if (!(group & 0x80)) return value;
+		}
+		throw std::runtime_error("Varint too long in packed data.");
+	}
+
+	uint32_t read_expgolomb() {
+		uint32_t length = 0;
+		while (read(1) == 0) {
+			if (++length > 31) throw std::runtime_error("Exp-Golomb code too long in packed data.");
+		}
+		uint32_t v = 1;
+		for (uint32_t b = 0; b < length; ++b) {
+			v = (v << 1) | read(1);
+		}
+		return v - 1;
+	}
+
+	//true if everything but the padding bits of the last byte has been read:
+	bool finished() const { return (at + 7) / 8 == bytes.size(); }
+
+	std::span< uint8_t const > bytes;
+	size_t at = 0; //bit index of the next read
+};
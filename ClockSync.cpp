@@ -0,0 +1,92 @@
+#include "ClockSync.hpp"
+
+#include "Connection.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+//messages:
+// ping: [type, size (24 bits), client send time (f64, client seconds), client's current rtt estimate (f32, 0 if unknown)]
+// pong: [type, size (24 bits), client send time (echoed), server game time when answered (f64)]
+// (both go unreliably over datagram transport, since a resent ping would only be a bad sample anyway)
+constexpr uint32_t PingSize = message_info(Message::C2S_Ping).min_size;
+constexpr uint32_t PongSize = message_info(Message::S2C_Pong).min_size;
+static_assert(PingSize == 8 + 4 && PongSize == 8 + 8, "MessageRegistry should match the layouts above.");
+
+double ClockSync::local_time(std::chrono::steady_clock::time_point now) const {
+	return std::chrono::duration< double >(now - epoch).count();
+}
+
+double ClockSync::server_time(std::chrono::steady_clock::time_point now) const {
+	return local_time(now) + offset;
+}
+
+uint32_t ClockSync::server_tick(std::chrono::steady_clock::time_point now, float tick) const {
+	if (!synced) return 0;
+	return uint32_t(std::max(1.0, std::floor(server_time(now) / double(tick))));
+}
+
+void ClockSync::update(Connection *connection, std::chrono::steady_clock::time_point now) {
+	assert(connection);
+	double local = local_time(now);
+	if (local < next_ping) return;
+	next_ping = local + (sample_count < StartupSamples ? StartupInterval : PingInterval);
+	pings_sent += 1;
+
+	uint8_t message[MessageHeaderSize + PingSize];
+	BufferWriter writer(message);
+	writer.begin(Message::C2S_Ping);
+	writer.write(local);
+	writer.write(synced ? rtt : 0.0f);
+	writer.finish();
+	connection->send_unreliable(writer.data(), writer.size(), nullptr);
+}
+
+void ClockSync::recv_pong_message(MessageView const &message, std::chrono::steady_clock::time_point now) {
+	double sent = message.read< double >(0);
+	double server = message.read< double >(8);
+
+	double received = local_time(now);
+	if (!(sent <= received) || !std::isfinite(server)) return; //(not one of ours -- ignore it)
+
+	//the server's time is taken to be from halfway through the round trip:
+	Sample &sample = samples[sample_count % Window];
+	sample_count += 1;
+	sample.rtt = float(received - sent);
+	sample.offset = server - 0.5 * (sent + received);
+
+	if (!synced) {
+		smoothed_rtt = sample.rtt;
+		jitter = 0.0f;
+	} else {
+		jitter += (std::abs(sample.rtt - smoothed_rtt) - jitter) * Smoothing;
+		smoothed_rtt += (sample.rtt - smoothed_rtt) * Smoothing;
+	}
+
+	//estimate from the least-delayed recent sample:
+	Sample const *best = &samples[0];
+	for (uint32_t i = 1; i < std::min(sample_count, Window); ++i) {
+		if (samples[i].rtt < best->rtt) best = &samples[i];
+	}
+	rtt = best->rtt;
+	offset = best->offset;
+	synced = true;
+}
+
+void ClockSync::recv_ping_message(Connection *connection, MessageView const &message, double server_time, float *client_rtt) {
+	assert(connection);
+	assert(client_rtt);
+
+	uint8_t pong[MessageHeaderSize + PongSize];
+	BufferWriter writer(pong);
+	writer.begin(Message::S2C_Pong);
+	writer.write(message.read< double >(0)); //(client time, echoed as-is)
+	writer.write(server_time);
+	writer.finish();
+
+	float reported = message.read< float >(8);
+	if (std::isfinite(reported) && reported >= 0.0f) *client_rtt = reported;
+
+	connection->send_unreliable(writer.data(), writer.size(), nullptr);
+}
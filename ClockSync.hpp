@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Game.hpp"
+
+#include <array>
+#include <chrono>
+
+struct Connection;
+
+//Client-side estimate of round-trip time and of the server's game clock (seconds since its first tick, so tick n happened at n * Game::tick):
+// the client pings a few times a second with its local send time; the server answers right away with its game time.
+// Each pong gives an RTT and an offset (assuming both legs took equally long), and the estimate comes from the
+// lowest-RTT sample among the last few (NTP-style), since queueing delay is what makes the legs uneven.
+struct ClockSync {
+	//send a ping if one is due (call every frame):
+	void update(Connection *connection, std::chrono::steady_clock::time_point now);
+
+	//update the estimate from a pong message (see MessageDispatch):
+	void recv_pong_message(MessageView const &message, std::chrono::steady_clock::time_point now);
+
+	//(server) answer a ping with the room's game time ('server_time', seconds),
+	// storing the RTT the client reported in 'client_rtt' (0 if it doesn't know yet):
+	static void recv_ping_message(Connection *connection, MessageView const &message, double server_time, float *client_rtt);
+
+	//estimates (valid once 'synced'):
+	bool synced = false;
+	float rtt = 0.0f; //round trip of the best recent sample (seconds)
+	float smoothed_rtt = 0.0f; //moving average of every sample
+	float jitter = 0.0f; //moving average of how far samples stray from smoothed_rtt
+	double offset = 0.0; //server game time minus local time
+
+	//server game time / tick at local time 'now' (for a server ticking every 'tick' seconds -- see Game::recv_rates_message):
+	double server_time(std::chrono::steady_clock::time_point now) const;
+	uint32_t server_tick(std::chrono::steady_clock::time_point now, float tick) const;
+
+	//tuning (seconds):
+	inline static constexpr float PingInterval = 0.25f;
+	inline static constexpr float StartupInterval = 0.05f; //(until the window has a few samples)
+	inline static constexpr uint32_t StartupSamples = 4;
+	inline static constexpr float Smoothing = 0.125f; //(weight of each new sample in smoothed_rtt / jitter)
+
+	//internals:
+	struct Sample {
+		float rtt = 0.0f;
+		double offset = 0.0;
+	};
+	inline static constexpr uint32_t Window = 16; //(recent samples the best one is picked from)
+	std::array< Sample, Window > samples;
+	uint32_t sample_count = 0; //samples recorded so far (the newest is at (sample_count - 1) % Window)
+
+	double local_time(std::chrono::steady_clock::time_point now) const; //(seconds since 'epoch')
+	std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	double next_ping = 0.0; //(local time)
+	uint32_t pings_sent = 0;
+};
@@ -25,6 +25,10 @@ typedef int ssize_t;
 #include <unistd.h>
 #include <netdb.h>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
 #define closesocket close
 
 #endif
@@ -45,15 +49,300 @@ typedef int ssize_t;
 //Also, some help and examples for getaddrinfo from: https://beej.us/guide/bgnet/html/multi/syscalls.html
 
 
+//---------------------------------
+//Datagram (UDP) transport:
+// every packet starts with a one-byte kind; multi-byte fields are little-endian.
+//  Hello / Welcome: [kind] -- client asks to join / server accepts (repeated until answered)
+//  Reliable: [kind][u32 offset][bytes] -- a piece of the reliable stream starting at 'offset'
+//  Ack: [kind][u32 next] -- all reliable bytes before 'next' were received (doubles as a keep-alive)
+//  Unreliable: [kind][u32 seq][message] -- one send_unreliable() message
+//  Bye: [kind] -- connection closed
+// The reliable channel is go-back-N: unacknowledged bytes stay in send_buffer and are resent after a timeout.
+
+enum DatagramKind : uint8_t {
+	DatagramHello = 1,
+	DatagramWelcome = 2,
+	DatagramReliable = 3,
+	DatagramAck = 4,
+	DatagramUnreliable = 5,
+	DatagramBye = 6,
+};
+
+constexpr size_t DatagramMaxSize = 1200; //stay under typical path MTU
+constexpr size_t DatagramHeaderSize = 5; //kind + u32
+constexpr uint32_t DatagramWindow = 32 * 1024; //max reliable bytes in flight
+constexpr auto DatagramRetransmit = std::chrono::milliseconds(100);
+constexpr auto DatagramKeepAlive = std::chrono::milliseconds(500);
+constexpr auto DatagramTimeout = std::chrono::seconds(5);
+
+static void put_u32(uint8_t *at, uint32_t val) {
+	at[0] = uint8_t(val);
+	at[1] = uint8_t(val >> 8);
+	at[2] = uint8_t(val >> 16);
+	at[3] = uint8_t(val >> 24);
+}
+
+static uint32_t get_u32(uint8_t const *at) {
+	return uint32_t(at[0]) | (uint32_t(at[1]) << 8) | (uint32_t(at[2]) << 16) | (uint32_t(at[3]) << 24);
+}
+
+//send one packet to c's peer (best effort; datagrams that can't be sent right now are just lost):
+static void send_datagram(Connection &c, uint8_t const *data, size_t size) {
+	assert(c.datagram);
+	auto &d = *c.datagram;
+	ssize_t ret;
+	if (d.peer.empty()) { //socket is connected to the peer
+		#ifdef _WIN32
+		ret = send(c.socket, reinterpret_cast< char const * >(data), int(size), MSG_DONTWAIT);
+		#else
+		ret = send(c.socket, data, size, MSG_DONTWAIT);
+		#endif
+	} else {
+		struct sockaddr_storage addr;
+		assert(d.peer.size() <= sizeof(addr));
+		memcpy(&addr, d.peer.data(), d.peer.size());
+		#ifdef _WIN32
+		ret = sendto(c.socket, reinterpret_cast< char const * >(data), int(size), MSG_DONTWAIT, reinterpret_cast< struct sockaddr const * >(&addr), int(d.peer.size()));
+		#else
+		ret = sendto(c.socket, data, size, MSG_DONTWAIT, reinterpret_cast< struct sockaddr const * >(&addr), socklen_t(d.peer.size()));
+		#endif
+	}
+	(void)ret; //(unreliable by design; lost packets are resent by the reliable channel or superseded)
+	d.last_send = std::chrono::steady_clock::now();
+}
+
+static void send_datagram_kind(Connection &c, DatagramKind kind) {
+	uint8_t packet = kind;
+	send_datagram(c, &packet, 1);
+}
+
+//---------------------------------
+
 void Connection::close() {
 	if (socket != InvalidSocket) {
-		::closesocket(socket);
+		if (datagram) {
+			//tell the peer (best effort):
+			send_datagram_kind(*this, DatagramBye);
+			//a server's peers all share its socket; only a client's connection (no peer address) owns one:
+			if (datagram->peer.empty()) ::closesocket(socket);
+		} else {
+			::closesocket(socket);
+		}
 		socket = InvalidSocket;
 	}
 }
 
+//add a block to c's queue, to go out after everything now in send_buffer:
+static Connection::SharedSend &queue_shared(Connection &c, SharedBytes const &bytes) {
+	size_t before = 0;
+	for (auto const &queued : c.send_shared_queue) before += queued.after;
+	assert(before <= c.send_buffer.size());
+	Connection::SharedSend &queued = c.send_shared_queue.emplace_back();
+	queued.bytes = bytes;
+	queued.after = c.send_buffer.size() - before;
+	return queued;
+}
+
+void Connection::send_shared(SharedBytes const &bytes) {
+	if (!bytes || bytes->empty()) return;
+	queue_shared(*this, bytes);
+}
+
+size_t Connection::pending_bytes() const {
+	size_t total = send_buffer.size();
+	for (auto const &queued : send_shared_queue) total += queued.size() - queued.offset;
+	return total;
+}
+
+//update whether 'c' is congested (see Connection::Backpressure), counting 'adding' bytes about to be queued:
+// (with hysteresis, so the policy doesn't flap at the threshold)
+static void update_congestion(Connection &c, size_t adding) {
+	size_t pending = c.pending_bytes();
+	if (!c.congested && pending + adding > c.backpressure.high_watermark) {
+		c.congested = true;
+		c.congestion_events += 1;
+	} else if (c.congested && pending < c.backpressure.low_watermark) {
+		c.congested = false;
+	}
+	if (c.congested && c.backpressure.policy == Connection::Backpressure::Disconnect) c.overflowed = true;
+}
+
+//drop c's queued droppable send_unreliable() messages of type 'type' that haven't started sending (see Backpressure::CoalesceStale):
+static void drop_unsent_stale(Connection &c, uint8_t type) {
+	size_t carry = 0; //(send_buffer bytes that went before a dropped block now go before the next one)
+	for (auto queued = c.send_shared_queue.begin(); queued != c.send_shared_queue.end(); /*later*/) {
+		queued->after += carry;
+		carry = 0;
+		if (queued->stale && queued->offset == 0 && queued->header[0] == type) {
+			carry = queued->after;
+			c.dropped_bytes += queued->size();
+			c.dropped_messages += 1;
+			queued = c.send_shared_queue.erase(queued);
+		} else {
+			++queued;
+		}
+	}
+	//(a 'carry' left over is just send_buffer bytes after the last block, which is where they already are)
+}
+
+//close 'c' if backpressure said to (see Backpressure::Disconnect), reporting it like any other disconnect:
+// (returns true if it did)
+static bool close_if_overflowed(char const *where, Connection &c, std::function< void(Connection *, Connection::Event event) > const &on_event) {
+	if (!c.overflowed || c.socket == InvalidSocket) return false;
+	std::cerr << "[" << where << "] peer isn't keeping up (" << c.pending_bytes() << " bytes waiting to send), disconnecting." << std::endl;
+	c.close();
+	if (on_event) on_event(&c, Connection::OnClose);
+	return true;
+}
+
 //---------------------------------
-//Polling helper used by both server and client:
+//Per-connection transfer helpers shared by both polling backends:
+
+//read from 'c' until the socket has no more data (or, if 'until_would_block' is false, until a short read):
+static void recv_available(char const *where, Connection &c, std::function< void(Connection *, Connection::Event event) > const &on_event, bool until_would_block) {
+	const uint32_t BufferSize = 20000;
+
+	while (true) { //read until more data left to read
+		//receive directly into free space at the back of recv_buffer:
+		std::span< uint8_t > free = c.recv_buffer.write_span(BufferSize);
+		#ifdef _WIN32
+		ssize_t ret = recv(c.socket, reinterpret_cast< char * >(free.data()), int(free.size()), MSG_DONTWAIT);
+		#else
+		ssize_t ret = recv(c.socket, free.data(), free.size(), MSG_DONTWAIT);
+		#endif
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			//~no problem~ but no data
+			break;
+		} else if (ret <= 0 || ret > (ssize_t)free.size()) {
+			//~problem~ so remove connection
+			if (ret == 0) {
+				std::cerr << "[" << where << "] port closed, disconnecting." << std::endl;
+			} else if (ret < 0) {
+				std::cerr << "[" << where << "] recv() returned error " << errno << "(" << strerror(errno) << "), disconnecting." << std::endl;
+			} else {
+				std::cerr << "[" << where << "] recv() returned strange number of bytes, disconnecting." << std::endl;
+			}
+			c.close();
+			if (on_event) on_event(&c, Connection::OnClose);
+			break;
+		} else { //ret > 0
+			c.recv_buffer.commit(size_t(ret));
+			if (on_event) on_event(&c, Connection::OnRecv);
+			if (c.socket == InvalidSocket) break; //on_event may have closed the connection
+			if (!until_would_block && ret < (ssize_t)free.size()) break; //ran out of data before buffer: no more data left to read
+		}
+	}
+}
+
+//collect (up to 'max_pieces') contiguous pieces of c's pending output, in send order:
+// (returns the number of pieces filled in)
+static size_t gather_pending(Connection const &c, std::span< uint8_t const > *pieces, size_t max_pieces) {
+	size_t count = 0;
+	size_t offset = 0; //position in send_buffer
+
+	//add 'size' bytes of send_buffer starting at 'offset':
+	auto gather_buffer = [&](size_t size) {
+		while (size > 0 && count < max_pieces) {
+			std::span< uint8_t const > span = c.send_buffer.read_span(offset);
+			span = span.first(std::min(span.size(), size));
+			pieces[count++] = span;
+			offset += span.size();
+			size -= span.size();
+		}
+	};
+
+	for (auto const &queued : c.send_shared_queue) {
+		gather_buffer(queued.after);
+		if (count == max_pieces) return count;
+		if (queued.offset < queued.header_size) {
+			pieces[count++] = std::span< uint8_t const >(queued.header.data() + queued.offset, queued.header_size - queued.offset);
+			if (count == max_pieces) return count;
+		}
+		size_t sent = queued.offset - std::min(queued.offset, size_t(queued.header_size)); //(of 'bytes')
+		if (queued.bytes && sent < queued.bytes->size()) {
+			pieces[count++] = std::span< uint8_t const >(queued.bytes->data() + sent, queued.bytes->size() - sent);
+			if (count == max_pieces) return count;
+		}
+	}
+	gather_buffer(c.send_buffer.size() - offset);
+
+	return count;
+}
+
+//drop 'size' sent bytes from the front of c's pending output:
+static void consume_sent(Connection &c, size_t size) {
+	while (size > 0) {
+		if (c.send_shared_queue.empty()) {
+			c.send_buffer.consume(size);
+			break;
+		}
+		auto &front = c.send_shared_queue.front();
+		if (front.after > 0) {
+			size_t amt = std::min(size, front.after);
+			c.send_buffer.consume(amt);
+			front.after -= amt;
+			size -= amt;
+		} else {
+			size_t amt = std::min(size, front.size() - front.offset);
+			front.offset += amt;
+			size -= amt;
+			if (front.offset == front.size()) c.send_shared_queue.pop_front();
+		}
+	}
+	//(the peer may have caught up)
+	if (c.congested) update_congestion(c, 0);
+}
+
+//send as much of c's pending output (send_buffer and queued shared blocks) as the socket will take right now:
+// (returns false if the socket would block)
+static bool send_pending(char const *where, Connection &c, std::function< void(Connection *, Connection::Event event) > const &on_event) {
+	while (c.sending()) {
+		constexpr size_t MaxPieces = 16;
+		std::span< uint8_t const > pieces[MaxPieces];
+		size_t piece_count = gather_pending(c, pieces, MaxPieces);
+		assert(piece_count > 0);
+
+		#ifdef _WIN32
+		//no gather on this path; just send the first piece:
+		size_t attempted = pieces[0].size();
+		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(pieces[0].data()), int(pieces[0].size()), MSG_DONTWAIT);
+		#else
+		//scatter/gather send straight from send_buffer and the shared blocks:
+		size_t attempted = 0;
+		struct iovec iov[MaxPieces];
+		for (size_t i = 0; i < piece_count; ++i) {
+			iov[i].iov_base = const_cast< uint8_t * >(pieces[i].data());
+			iov[i].iov_len = pieces[i].size();
+			attempted += pieces[i].size();
+		}
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = piece_count;
+		ssize_t ret = sendmsg(c.socket, &msg, MSG_DONTWAIT);
+		#endif 
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			//~no problem~, but don't keep trying
+			return false;
+		} else if (ret <= 0 || ret > (ssize_t)attempted) {
+			if (ret < 0) {
+				std::cerr << "[" << where << "] send() returned error " << errno << ", disconnecting." << std::endl;
+			} else { assert(ret == 0 || ret > (ssize_t)attempted);
+				std::cerr << "[" << where << "] send() returned strange number of bytes [" << ret << " of " << attempted << "], disconnecting." << std::endl;
+			}
+			c.close();
+			if (on_event) on_event(&c, Connection::OnClose);
+			break;
+		} else { //ret seems reasonable
+			consume_sent(c, size_t(ret));
+			if (ret < (ssize_t)attempted) return false; //socket buffer is full
+		}
+	}
+	return true;
+}
+
+//---------------------------------
+//select()-based polling helper used by both server and client:
 void poll_connections(
 	char const *where,
 	std::list< Connection > &connections,
@@ -74,11 +363,12 @@ void poll_connections(
 	}
 
 	//add each connection's socket to read (and possibly write) sets:
-	for (auto c : connections) {
+	for (auto &c : connections) {
+		if (close_if_overflowed(where, c, on_event)) continue;
 		if (c.socket != InvalidSocket) {
 			max = std::max(max, int(c.socket));
 			FD_SET(c.socket, &read_fds);
-			if (!c.send_buffer.empty()) {
+			if (c.sending()) {
 				FD_SET(c.socket, &write_fds);
 			}
 		}
@@ -119,72 +409,380 @@ void poll_connections(
 		}
 	}
 
-	const uint32_t BufferSize = 20000;
-	static thread_local char *buffer = new char[BufferSize];
-
 	//process requests:
 	for (auto &c : connections) {
 		//only read from valid sockets marked readable:
 		if (c.socket == InvalidSocket || !FD_ISSET(c.socket, &read_fds)) continue;
 
-		while (true) { //read until more data left to read
-			ssize_t ret = recv(c.socket, buffer, BufferSize, MSG_DONTWAIT);
-			if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-				//~no problem~ but no data
-				break;
-			} else if (ret <= 0 || ret > (ssize_t)BufferSize) {
-				//~problem~ so remove connection
-				if (ret == 0) {
-					std::cerr << "[" << where << "] port closed, disconnecting." << std::endl;
-				} else if (ret < 0) {
-					std::cerr << "[" << where << "] recv() returned error " << errno << "(" << strerror(errno) << "), disconnecting." << std::endl;
-				} else {
-					std::cerr << "[" << where << "] recv() returned strange number of bytes, disconnecting." << std::endl;
-				}
-				c.close();
-				if (on_event) on_event(&c, Connection::OnClose);
-				break;
-			} else { //ret > 0
-				c.recv_buffer.insert(c.recv_buffer.end(), buffer, buffer + ret);
-				if (on_event) on_event(&c, Connection::OnRecv);
-				if (ret < BufferSize) break; //ran out of data before buffer: no more data left to read
-			}
-		}
+		recv_available(where, c, on_event, false);
 	}
 
 	//process responses:
 	for (auto &c : connections) {
 		//don't bother with connections unless they are valid, have something to send, and are marked writable:
-		if (c.socket == InvalidSocket || c.send_buffer.empty() || !FD_ISSET(c.socket, &write_fds)) continue;
+		if (c.socket == InvalidSocket || !c.sending() || !FD_ISSET(c.socket, &write_fds)) continue;
+
+		send_pending(where, c, on_event);
+	}
+
 		
-		#ifdef _WIN32
-		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(c.send_buffer.data()), int(c.send_buffer.size()), MSG_DONTWAIT);
-		#else
-		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(c.send_buffer.data()), c.send_buffer.size(), MSG_DONTWAIT);
-		#endif 
-		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-			//~no problem~, but don't keep trying
-			break;
-		} else if (ret <= 0 || ret > (ssize_t)c.send_buffer.size()) {
-			if (ret < 0) {
-				std::cerr << "[" << where << "] send() returned error " << errno << ", disconnecting." << std::endl;
-			} else { assert(ret == 0 || ret > (ssize_t)c.send_buffer.size());
-				std::cerr << "[" << where << "] send() returned strange number of bytes [" << ret << " of " << c.send_buffer.size() << "], disconnecting." << std::endl;
+}
+
+#ifdef __linux__
+//---------------------------------
+//epoll()-based polling helper used by both server and client:
+// connection sockets are registered edge-triggered (so must be drained on every wakeup);
+// the listen socket is level-triggered (so one accept() per wakeup is fine).
+
+static void epoll_register(int epoll_fd, Connection &c) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = &c; //(connections live in a std::list, so this address is stable until reaped)
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c.socket, &ev) != 0) {
+		throw std::system_error(errno, std::system_category(), "failed to add socket to epoll");
+	}
+}
+
+//register a listen (or datagram) socket -- level-triggered, marked by a null data pointer:
+static void epoll_register_listener(int epoll_fd, Socket socket) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = nullptr;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket, &ev) != 0) {
+		throw std::system_error(errno, std::system_category(), "failed to add listen socket to epoll");
+	}
+}
+
+//register a wakeup fd (see Server::add_wakeup) -- level-triggered, marked by pointing at WakeupMarker:
+static char WakeupMarker;
+static void epoll_register_wakeup(int epoll_fd, int fd) {
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = &WakeupMarker;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		throw std::system_error(errno, std::system_category(), "failed to add wakeup fd to epoll");
+	}
+}
+
+void poll_connections_epoll(
+	char const *where,
+	std::list< Connection > &connections,
+	std::function< void(Connection *, Connection::Event event) > const &on_event,
+	double timeout,
+	int epoll_fd,
+	Socket listen_socket = InvalidSocket) {
+
+	//flush anything queued since the last poll to sockets already known to be writable:
+	// (otherwise it would sit until the socket reports some other event)
+	for (auto &c : connections) {
+		if (close_if_overflowed(where, c, on_event)) continue;
+		if (c.socket == InvalidSocket || !c.sending() || !c.writable) continue;
+		c.writable = send_pending(where, c, on_event);
+	}
+
+	constexpr int MaxEvents = 256;
+	static thread_local struct epoll_event events[MaxEvents];
+
+	//wait (until timeout) for sockets' data to become available:
+	// (epoll timeouts are in milliseconds; round up so short waits don't turn into busy-polling)
+	int timeout_ms = int(std::ceil(std::max(0.0, timeout) * 1000.0));
+	int count = epoll_wait(epoll_fd, events, MaxEvents, timeout_ms);
+	if (count < 0) {
+		if (errno != EINTR) {
+			std::cerr << "[" << where << "] epoll_wait returned error " << errno << "(" << strerror(errno) << ")." << std::endl;
+		}
+		return;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		if (events[i].data.ptr == &WakeupMarker) continue; //(only here to end the wait)
+		if (events[i].data.ptr == nullptr) {
+			//listen socket is readable => new connection:
+			Socket got = accept(listen_socket, NULL, NULL);
+			if (got == InvalidSocket) continue; //oh well.
+			connections.emplace_back();
+			connections.back().socket = got;
+			epoll_register(epoll_fd, connections.back());
+			std::cerr << "[" << where << "] client connected on " << connections.back().socket << "." << std::endl; //INFO
+			if (on_event) on_event(&connections.back(), Connection::OnOpen);
+			continue;
+		}
+
+		Connection &c = *reinterpret_cast< Connection * >(events[i].data.ptr);
+		if (c.socket == InvalidSocket) continue; //closed earlier in this poll (will be reaped by caller)
+
+		if (events[i].events & EPOLLOUT) c.writable = true;
+
+		if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+			recv_available(where, c, on_event, true);
+		}
+
+		if (c.socket != InvalidSocket && c.writable && c.sending()) {
+			c.writable = send_pending(where, c, on_event);
+		}
+	}
+}
+#endif
+
+//---------------------------------
+
+
+//---------------------------------
+//Datagram (UDP) transport (packet format and helpers are at the top of this file):
+
+void Connection::send_unreliable(void const *header, size_t header_size, SharedBytes const &payload, bool droppable) {
+	size_t payload_size = (payload ? payload->size() : 0);
+
+	//is the peer keeping up?
+	update_congestion(*this, header_size + payload_size);
+
+	if (!datagram && droppable) {
+		//stream connection: queue it as one block, so it can be dropped as a whole later
+		assert(header_size > 0 && header_size <= SharedSend::MaxHeader && "droppable messages keep their header inline; raise MaxHeader for bigger ones");
+		if (congested) {
+			if (backpressure.policy != Backpressure::CoalesceStale) {
+				dropped_bytes += header_size + payload_size;
+				dropped_messages += 1;
+				return;
 			}
+			drop_unsent_stale(*this, reinterpret_cast< uint8_t const * >(header)[0]);
+		}
+		SharedSend &queued = queue_shared(*this, payload);
+		memcpy(queued.header.data(), header, header_size);
+		queued.header_size = uint8_t(header_size);
+		queued.stale = true;
+		return;
+	}
+	//(datagram connections don't queue these, so for them only Backpressure::Disconnect applies -- to the reliable channel's backlog)
+
+	if (!datagram || DatagramHeaderSize + header_size + payload_size > DatagramMaxSize) {
+		//stream connection (or message too big for one datagram): send reliably instead
+		send_raw(header, header_size);
+		if (datagram) { //(the datagram reliable channel sends straight from send_buffer)
+			if (payload) send_raw(payload->data(), payload->size());
+		} else {
+			send_shared(payload);
+		}
+		return;
+	}
+	if (socket == InvalidSocket) return;
+
+	static thread_local uint8_t packet[DatagramMaxSize];
+	packet[0] = DatagramUnreliable;
+	put_u32(packet + 1, datagram->unreliable_send_seq++);
+	memcpy(packet + DatagramHeaderSize, header, header_size);
+	if (payload_size) memcpy(packet + DatagramHeaderSize + header_size, payload->data(), payload_size);
+	send_datagram(*this, packet, DatagramHeaderSize + header_size + payload_size);
+}
+
+//send whatever c's reliable channel needs to send right now (new data, retransmits, acks, keep-alives):
+static void flush_datagram(Connection &c, std::chrono::steady_clock::time_point now) {
+	assert(c.datagram);
+	auto &d = *c.datagram;
+
+	uint32_t in_flight = d.send_next - d.send_acked;
+	if (in_flight > 0 && now >= d.retransmit_at) {
+		//go back and resend everything not yet acknowledged:
+		d.send_next = d.send_acked;
+		in_flight = 0;
+	}
+
+	static thread_local uint8_t packet[DatagramMaxSize];
+	while (in_flight < c.send_buffer.size() && in_flight < DatagramWindow) {
+		size_t amount = std::min(c.send_buffer.size() - in_flight, DatagramMaxSize - DatagramHeaderSize);
+		packet[0] = DatagramReliable;
+		put_u32(packet + 1, d.send_next);
+		c.send_buffer.copy_out(in_flight, packet + DatagramHeaderSize, amount);
+		if (in_flight == 0) d.retransmit_at = now + DatagramRetransmit;
+		send_datagram(c, packet, DatagramHeaderSize + amount);
+		d.send_next += uint32_t(amount);
+		in_flight += uint32_t(amount);
+	}
+
+	if (d.ack_pending || now - d.last_send >= DatagramKeepAlive) {
+		packet[0] = DatagramAck;
+		put_u32(packet + 1, d.recv_next);
+		send_datagram(c, packet, DatagramHeaderSize);
+		d.ack_pending = false;
+	}
+}
+
+//handle one packet from c's peer:
+static void recv_datagram(char const *where, Connection &c, uint8_t const *data, size_t size, std::function< void(Connection *, Connection::Event event) > const &on_event) {
+	assert(c.datagram);
+	auto &d = *c.datagram;
+	auto now = std::chrono::steady_clock::now();
+	d.last_recv = now;
+
+	if (size == 0) return;
+	uint8_t kind = data[0];
+	if (kind == DatagramHello) {
+		//(client didn't hear the welcome yet)
+		send_datagram_kind(c, DatagramWelcome);
+	} else if (kind == DatagramWelcome) {
+		//(duplicate welcome; nothing to do)
+	} else if (kind == DatagramBye) {
+		std::cerr << "[" << where << "] peer said goodbye, disconnecting." << std::endl;
+		c.close();
+		if (on_event) on_event(&c, Connection::OnClose);
+	} else if (size < DatagramHeaderSize) {
+		//truncated packet; ignore
+	} else if (kind == DatagramReliable) {
+		uint32_t offset = get_u32(data + 1);
+		uint32_t length = uint32_t(size - DatagramHeaderSize);
+		uint32_t have = d.recv_next - offset; //bytes of this packet that were already received
+		d.ack_pending = true;
+		if (int32_t(have) >= 0 && have < length) {
+			c.recv_buffer.append(data + DatagramHeaderSize + have, length - have);
+			d.recv_next += length - have;
+			if (on_event) on_event(&c, Connection::OnRecv);
+		}
+		//(otherwise: a duplicate, or a packet after a gap that the sender will resend in order)
+	} else if (kind == DatagramAck) {
+		uint32_t next = get_u32(data + 1);
+		uint32_t advance = next - d.send_acked;
+		if (int32_t(advance) > 0 && advance <= c.send_buffer.size()) {
+			c.send_buffer.consume(advance);
+			if (c.congested) update_congestion(c, 0); //(the peer may have caught up)
+			d.send_acked = next;
+			if (int32_t(d.send_next - d.send_acked) < 0) d.send_next = d.send_acked;
+			d.retransmit_at = now + DatagramRetransmit;
+		}
+	} else if (kind == DatagramUnreliable) {
+		uint32_t seq = get_u32(data + 1);
+		if (d.got_unreliable && int32_t(seq - d.unreliable_recv_seq) <= 0) {
+			//older than (or same as) something already received:
+			d.stale_dropped += 1;
+			return;
+		}
+		d.got_unreliable = true;
+		d.unreliable_recv_seq = seq;
+		//(one slot -- the last message should have been consumed by the OnRecv that reported it)
+		assert(c.unreliable_recv_buffer.empty() && "handle each unreliable message in its OnRecv; the next one replaces it");
+		c.unreliable_recv_buffer.clear();
+		c.unreliable_recv_buffer.append(data + DatagramHeaderSize, size - DatagramHeaderSize);
+		if (on_event) on_event(&c, Connection::OnRecv);
+	}
+}
+
+//wait (up to 'timeout' seconds) for 'socket' to become readable:
+static void wait_readable(Socket socket, int epoll_fd, double timeout) {
+	#ifdef __linux__
+	if (epoll_fd >= 0) {
+		struct epoll_event event;
+		epoll_wait(epoll_fd, &event, 1, int(std::ceil(std::max(0.0, timeout) * 1000.0)));
+		return;
+	}
+	#else
+	(void)epoll_fd;
+	#endif
+	fd_set read_fds;
+	FD_ZERO(&read_fds);
+	FD_SET(socket, &read_fds);
+	struct timeval tv;
+	tv.tv_sec = std::lround(std::floor(timeout));
+	tv.tv_usec = std::lround((timeout - std::floor(timeout)) * 1e6);
+	select(int(socket) + 1, &read_fds, NULL, NULL, &tv);
+}
+
+//Polling helper for datagram servers and clients:
+// all connections share 'socket'; if 'peers' is non-null (server), packets from new addresses open new connections.
+void poll_datagrams(
+	char const *where,
+	std::list< Connection > &connections,
+	std::function< void(Connection *, Connection::Event event) > const &on_event,
+	double timeout,
+	Socket socket,
+	int epoll_fd,
+	std::unordered_map< std::string, Connection * > *peers) {
+
+	auto now = std::chrono::steady_clock::now();
+	for (auto &c : connections) {
+		if (close_if_overflowed(where, c, on_event)) continue;
+		if (c.socket == InvalidSocket) continue;
+		if (now - c.datagram->last_recv > DatagramTimeout) {
+			std::cerr << "[" << where << "] peer timed out, disconnecting." << std::endl;
 			c.close();
 			if (on_event) on_event(&c, Connection::OnClose);
-		} else { //ret seems reasonable
-			c.send_buffer.erase(c.send_buffer.begin(), c.send_buffer.begin() + ret);
+			continue;
 		}
+		flush_datagram(c, now);
 	}
 
-		
-}
+	wait_readable(socket, epoll_fd, timeout);
 
-//---------------------------------
+	//read every waiting packet:
+	static thread_local uint8_t packet[DatagramMaxSize];
+	while (true) {
+		struct sockaddr_storage addr;
+		socklen_t addr_size = sizeof(addr);
+		#ifdef _WIN32
+		ssize_t ret = recvfrom(socket, reinterpret_cast< char * >(packet), int(DatagramMaxSize), MSG_DONTWAIT, reinterpret_cast< struct sockaddr * >(&addr), &addr_size);
+		#else
+		ssize_t ret = recvfrom(socket, packet, DatagramMaxSize, MSG_DONTWAIT, reinterpret_cast< struct sockaddr * >(&addr), &addr_size);
+		#endif
+		if (ret < 0) break; //(EAGAIN -- or an ICMP error from an earlier send, which timeouts will take care of)
 
+		Connection *c = nullptr;
+		if (peers) {
+			std::string peer(reinterpret_cast< char const * >(&addr), size_t(addr_size));
+			auto f = peers->find(peer);
+			if (f != peers->end()) {
+				c = f->second;
+			} else if (ret >= 1 && packet[0] == DatagramHello) {
+				//new peer:
+				connections.emplace_back();
+				c = &connections.back();
+				c->socket = socket;
+				c->datagram = std::make_unique< Connection::Datagram >();
+				c->datagram->peer = peer;
+				c->datagram->last_recv = now;
+				peers->emplace(peer, c);
+				std::cerr << "[" << where << "] client connected (datagram)." << std::endl; //INFO
+				if (on_event) on_event(c, Connection::OnOpen);
+			} else {
+				continue; //stray packet from an unknown (or already-closed) peer
+			}
+		} else {
+			assert(connections.size() == 1);
+			c = &connections.front();
+		}
+		if (c->socket == InvalidSocket) continue;
+		recv_datagram(where, *c, packet, size_t(ret), on_event);
+	}
 
-Server::Server(std::string const &port) {
+	//send acks (and any replies queued by on_event) right away:
+	now = std::chrono::steady_clock::now();
+	for (auto &c : connections) {
+		if (c.socket == InvalidSocket) continue;
+		flush_datagram(c, now);
+	}
+}
+
+//create an epoll instance if 'backend' asks for one:
+// (returns -1 for the select backend)
+static int create_epoll(PollBackend backend) {
+	if (backend != PollBackend::Epoll) return -1;
+	#ifdef __linux__
+	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		throw std::system_error(errno, std::system_category(), "failed to create epoll instance");
+	}
+	return epoll_fd;
+	#else
+	throw std::runtime_error("The epoll poll backend is only available on linux.");
+	#endif
+}
+
+Server::Server(std::string const &port, PollBackend backend_, bool share_port, Transport transport_) : backend(backend_), transport(transport_) {
+	#ifndef __linux__
+	if (share_port) {
+		throw std::runtime_error("Sharing a listen port between servers is only supported on linux.");
+	}
+	#endif
 
 	#ifdef _WIN32
 	{ //init winsock:
@@ -199,7 +797,7 @@ Server::Server(std::string const &port) {
 		struct addrinfo hints;
 		memset(&hints, 0, sizeof(hints));
 		hints.ai_family = AF_UNSPEC;
-		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_socktype = (transport == Transport::Datagram ? SOCK_DGRAM : SOCK_STREAM);
 		hints.ai_flags = AI_PASSIVE;
 
 		struct addrinfo *res = nullptr;
@@ -247,6 +845,17 @@ Server::Server(std::string const &port) {
 				}
 			}
 
+			#ifdef __linux__
+			if (share_port) { //let other sockets bind the same port (kernel balances incoming connections between them):
+				int one = 1;
+				if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0) {
+					std::cout << "(failed to set SO_REUSEPORT: " << strerror(errno) << ")" << std::endl;
+					closesocket(s);
+					continue;
+				}
+			}
+			#endif
+
 			int ret = bind(s, info->ai_addr, int(info->ai_addrlen));
 			if (ret < 0) {
 				std::cout << "(failed to bind: " << strerror(errno) << ")" << std::endl;
@@ -265,29 +874,66 @@ Server::Server(std::string const &port) {
 		throw std::runtime_error("Failed to bind to port " + port);
 	}
 
-	{ //listen on socket
+	if (transport == Transport::Datagram) {
+		//(datagram sockets don't listen; poll() reads packets from every peer off this one socket)
+		#ifdef _WIN32
+		unsigned long one = 1;
+		if (0 != ioctlsocket(listen_socket, FIONBIO, &one)) {
+			throw std::runtime_error("failed to make datagram socket non-blocking");
+		}
+		#endif
+	} else { //listen on socket
 		int ret = ::listen(listen_socket, 5);
 		if (ret < 0) {
 			closesocket(listen_socket);
 			throw std::system_error(errno, std::system_category(), "failed to listen on socket");
 		}
 	}
+
+	epoll_fd = create_epoll(backend);
+	#ifdef __linux__
+	if (epoll_fd >= 0) epoll_register_listener(epoll_fd, listen_socket);
+	#endif
+}
+
+Server::~Server() {
+	#ifdef __linux__
+	if (epoll_fd >= 0) ::close(epoll_fd);
+	#endif
+}
+
+void Server::add_wakeup(int fd) {
+	#ifdef __linux__
+	if (epoll_fd >= 0) {
+		epoll_register_wakeup(epoll_fd, fd);
+		return;
+	}
+	#endif
+	(void)fd;
+	throw std::runtime_error("Server::add_wakeup needs the epoll poll backend.");
 }
 
 void Server::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout) {
-	poll_connections("Server::poll", connections, on_event, timeout, listen_socket);
+	if (transport == Transport::Datagram) poll_datagrams("Server::poll", connections, on_event, timeout, listen_socket, epoll_fd, &datagram_peers);
+	#ifdef __linux__
+	else if (backend == PollBackend::Epoll) poll_connections_epoll("Server::poll", connections, on_event, timeout, epoll_fd, listen_socket);
+	else poll_connections("Server::poll", connections, on_event, timeout, listen_socket);
+	#else
+	else poll_connections("Server::poll", connections, on_event, timeout, listen_socket);
+	#endif
 
 	//reap closed clients:
 	for (auto connection = connections.begin(); connection != connections.end(); /*later*/) {
 		auto old = connection;
 		++connection;
 		if (old->socket == InvalidSocket) {
+			if (old->datagram) datagram_peers.erase(old->datagram->peer);
 			connections.erase(old);
 		}
 	}
 }
 
-Client::Client(std::string const &host, std::string const &port) : connections(1), connection(connections.front()) {
+Client::Client(std::string const &host, std::string const &port, PollBackend backend_, Transport transport_) : connections(1), connection(connections.front()), backend(backend_), transport(transport_) {
 	#ifdef _WIN32
 	{ //init winsock:
 		WSADATA info;
@@ -301,8 +947,13 @@ Client::Client(std::string const &host, std::string const &port) : connections(1
 		struct addrinfo hints;
 		memset(&hints, 0, sizeof(hints));
 		hints.ai_family = AF_UNSPEC;
-		hints.ai_socktype = SOCK_STREAM;
-		hints.ai_protocol = IPPROTO_TCP;
+		if (transport == Transport::Datagram) {
+			hints.ai_socktype = SOCK_DGRAM;
+			hints.ai_protocol = IPPROTO_UDP;
+		} else {
+			hints.ai_socktype = SOCK_STREAM;
+			hints.ai_protocol = IPPROTO_TCP;
+		}
 
 		struct addrinfo *res = nullptr;
 		int addrinfo_ret = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
@@ -352,10 +1003,67 @@ Client::Client(std::string const &host, std::string const &port) : connections(1
 			throw std::runtime_error("Failed to connect to any of the addresses tried for server.");
 		}
 	}
+
+	if (transport == Transport::Datagram) { //(a "connected" UDP socket only fixes the peer address) -- say hello until the server answers:
+		connection.datagram = std::make_unique< Connection::Datagram >();
+		#ifdef _WIN32
+		unsigned long one = 1;
+		ioctlsocket(connection.socket, FIONBIO, &one);
+		#endif
+
+		auto give_up = std::chrono::steady_clock::now() + DatagramTimeout;
+		bool welcomed = false;
+		while (!welcomed && std::chrono::steady_clock::now() < give_up) {
+			send_datagram_kind(connection, DatagramHello);
+			wait_readable(connection.socket, -1, 0.1);
+			uint8_t reply[DatagramMaxSize];
+			while (true) {
+				#ifdef _WIN32
+				ssize_t ret = recv(connection.socket, reinterpret_cast< char * >(reply), int(sizeof(reply)), MSG_DONTWAIT);
+				#else
+				ssize_t ret = recv(connection.socket, reply, sizeof(reply), MSG_DONTWAIT);
+				#endif
+				if (ret < 0) break;
+				if (ret >= 1 && reply[0] == DatagramWelcome) welcomed = true;
+				//(anything else that arrives before the welcome is dropped; the reliable channel will resend it)
+			}
+		}
+		if (!welcomed) {
+			connection.close();
+			throw std::runtime_error("No answer from server at " + host + ":" + port + " (datagram).");
+		}
+		connection.datagram->last_recv = std::chrono::steady_clock::now();
+	}
+
+	epoll_fd = create_epoll(backend);
+	#ifdef __linux__
+	if (epoll_fd >= 0) {
+		if (transport == Transport::Datagram) epoll_register_listener(epoll_fd, connection.socket);
+		else epoll_register(epoll_fd, connection);
+	}
+	#endif
+}
+
+Client::~Client() {
+	//(datagram connections say goodbye, rather than waiting for the server to time them out)
+	if (transport == Transport::Datagram) connection.close();
+	#ifdef __linux__
+	if (epoll_fd >= 0) ::close(epoll_fd);
+	#endif
 }
 
 
 void Client::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout) {
+	if (transport == Transport::Datagram) {
+		if (connection.socket != InvalidSocket) poll_datagrams("Client::poll", connections, on_event, timeout, connection.socket, epoll_fd, nullptr);
+		return;
+	}
+	#ifdef __linux__
+	if (backend == PollBackend::Epoll) {
+		poll_connections_epoll("Client::poll", connections, on_event, timeout, epoll_fd, InvalidSocket);
+		return;
+	}
+	#endif
 	poll_connections("Client::poll", connections, on_event, timeout, InvalidSocket);
 }
 
@@ -14,7 +14,8 @@ int main(int argc, char **argv) {
 		server.poll([](Connection *connection, Connection::Event evt){
 			if (evt == Connection::OnRecv) {
 				//extract and erase data from the connection's recv_buffer:
-				std::vector< uint8_t > data = connection->recv_buffer;
+				std::vector< uint8_t > data(connection->recv_buffer.size());
+				connection->recv_buffer.copy_out(0, data.data(), data.size());
 				connection->recv_buffer.clear();
 				//send to other connections:
 
@@ -60,13 +61,35 @@ int main(int argc, char **argv) {
 #endif
 //--------- ---------------------------------- ---------
 
+#include "RingBuffer.hpp"
+
+#include <array>
 #include <vector>
 #include <list>
+#include <memory>
 #include <string>
 #include <functional>
+#include <unordered_map>
+#include <chrono>
 #include <cstdint>
 
-//Thin wrapper around a (polling-based) TCP socket connection:
+//Immutable, reference-counted block of bytes that can be queued on many connections at once:
+typedef std::shared_ptr< std::vector< uint8_t > const > SharedBytes;
+
+//Which OS facility Server/Client::poll() uses to wait for socket activity:
+enum class PollBackend {
+	Select, //portable; rebuilds fd_sets on every poll() and is limited to FD_SETSIZE sockets
+	Epoll, //linux only; sockets are registered once and poll() only visits ready sockets
+};
+
+//What carries a connection's bytes:
+enum class Transport {
+	Stream, //TCP; everything is reliable and ordered
+	Datagram, //UDP; send_buffer / recv_buffer ride a small reliable, ordered channel,
+	          // and send_unreliable() messages are sequenced datagrams that are dropped if lost or stale
+};
+
+//Thin wrapper around a (polling-based) TCP or UDP socket connection:
 struct Connection {
 	//Helper that will append any type to the send buffer:
 	template< typename T >
@@ -75,8 +98,46 @@ struct Connection {
 	}
 	//Helper that will append raw bytes to the send buffer:
 	void send_raw(void const *data, size_t size) {
-		send_buffer.insert(send_buffer.end(), reinterpret_cast< uint8_t const * >(data), reinterpret_cast< uint8_t const * >(data) + size);
+		send_buffer.append(data, size);
 	}
+	//Queue a shared block of bytes to go out after everything already in send_buffer:
+	// (the block is sent straight from its own storage, so one encoding can be queued on many connections without copying)
+	void send_shared(SharedBytes const &bytes);
+
+	//Send a message that is only useful until a newer one arrives (e.g., a state snapshot):
+	// - on datagram connections it goes out immediately as one sequenced datagram; if it is lost, or arrives
+	//   after a newer one, it is dropped. The receiver finds it in unreliable_recv_buffer.
+	// - on stream connections it is queued like send_raw(header) + send_shared(payload).
+	//   If 'droppable' -- only for messages that a newer one of the same type fully replaces -- then while the peer isn't
+	//   keeping up (see Backpressure) it may be dropped, or replaced by a newer one of its type that hasn't started sending.
+	//   (the type is header[0], as framed in Message.hpp)
+	void send_unreliable(void const *header, size_t header_size, SharedBytes const &payload, bool droppable = false);
+
+	//Is anything (in send_buffer or queued shared blocks) still waiting to be sent?
+	bool sending() const { return !send_buffer.empty() || !send_shared_queue.empty(); }
+
+	//Bytes waiting to be sent (send_buffer plus what is left of queued shared blocks):
+	// (on datagram connections, send_buffer holds reliable bytes until they are acknowledged)
+	size_t pending_bytes() const;
+
+	//What to do about a peer that reads slower than we send:
+	// once pending_bytes() goes over 'high_watermark' the connection is congested, until it drains below 'low_watermark'.
+	// (adjust per connection -- e.g., when the server reports OnOpen)
+	struct Backpressure {
+		size_t high_watermark = 256 * 1024;
+		size_t low_watermark = 64 * 1024;
+		enum Policy : uint8_t {
+			DropStale, //droppable send_unreliable() messages are dropped while congested
+			CoalesceStale, //while congested, a droppable message replaces the queued ones of its type not yet started (so only the newest waits)
+			Disconnect, //the connection is closed (OnClose is reported by the next poll())
+		} policy = CoalesceStale;
+	} backpressure;
+	bool congested = false;
+
+	//stats:
+	uint64_t dropped_bytes = 0; //droppable send_unreliable() bytes dropped or replaced before they were sent
+	uint32_t dropped_messages = 0;
+	uint32_t congestion_events = 0; //times pending_bytes() went over backpressure.high_watermark
 
 	//Call 'close' to mark a connection for discard:
 	void close();
@@ -85,12 +146,87 @@ struct Connection {
 	explicit operator bool() { return socket != InvalidSocket; }
 
 	//To send data over a connection, append it to send_buffer:
-	std::vector< uint8_t > send_buffer;
+	RingBuffer send_buffer;
 	//When the connection receives data, it is appended to recv_buffer:
-	std::vector< uint8_t > recv_buffer;
+	// (parsers consume() messages from the front once handled)
+	RingBuffer recv_buffer;
+	//(datagram connections) the newest send_unreliable() message received -- one whole message, of any type:
+	// this is a single slot, so handle (and consume) it in the OnRecv that reports it, as MessageDispatch::dispatch(Connection *) does;
+	// it must be empty by the time the next one arrives, which replaces it.
+	RingBuffer unreliable_recv_buffer;
 
 	//internals:
+	struct SharedSend {
+		SharedBytes bytes; //(may be null for a header-only unreliable message)
+		size_t offset = 0; //bytes of 'header' then 'bytes' already sent
+		size_t after = 0; //send_buffer bytes (counted from the previous queued block, or the front) that go before this block
+		//(stream droppable send_unreliable() messages) small header sent ahead of 'bytes', kept here so the message can be dropped as a whole:
+		inline static constexpr size_t MaxHeader = 32;
+		std::array< uint8_t, MaxHeader > header;
+		uint8_t header_size = 0;
+		bool stale = false; //(a droppable send_unreliable() message -- may be dropped, or replaced by a newer one of type header[0], under backpressure)
+		size_t size() const { return header_size + (bytes ? bytes->size() : 0); }
+	};
+	//(a vector used as a queue: popped entries are reclaimed in bulk, so once it has grown to the most blocks ever queued,
+	// queueing and sending don't allocate -- a std::deque would allocate a new chunk every few blocks)
+	struct SharedSendQueue {
+		std::vector< SharedSend > entries;
+		size_t head = 0; //(entries before 'head' have been popped)
+
+		bool empty() const { return head == entries.size(); }
+		size_t size() const { return entries.size() - head; }
+		SharedSend &front() { return entries[head]; }
+		std::vector< SharedSend >::iterator begin() { return entries.begin() + head; }
+		std::vector< SharedSend >::iterator end() { return entries.end(); }
+		std::vector< SharedSend >::const_iterator begin() const { return entries.begin() + head; }
+		std::vector< SharedSend >::const_iterator end() const { return entries.end(); }
+
+		SharedSend &emplace_back() {
+			//(reuse popped entries' room before growing)
+			if (head > 0 && entries.size() == entries.capacity()) {
+				entries.erase(entries.begin(), entries.begin() + head);
+				head = 0;
+			}
+			return entries.emplace_back();
+		}
+		void pop_front() {
+			entries[head] = SharedSend(); //(let go of the block's bytes now)
+			head += 1;
+			if (head == entries.size()) clear();
+		}
+		std::vector< SharedSend >::iterator erase(std::vector< SharedSend >::iterator at) { return entries.erase(at); }
+		void clear() {
+			entries.clear();
+			head = 0;
+		}
+	};
+	SharedSendQueue send_shared_queue;
+	bool overflowed = false; //(Backpressure::Disconnect triggered; poll() closes the connection)
+
 	Socket socket = InvalidSocket;
+	bool writable = false; //(epoll backend) set when the socket reports it can take more data, cleared on EAGAIN
+
+	//(datagram transport) per-peer channel state; null for stream connections:
+	struct Datagram {
+		std::string peer; //peer's sockaddr bytes (empty if the socket is connected to the peer)
+
+		//reliable channel, as a stream of bytes numbered from zero (wrapping at 2^32):
+		uint32_t send_acked = 0; //stream offset of send_buffer[0]; everything before it has been acknowledged
+		uint32_t send_next = 0; //stream offset of the next byte to transmit
+		uint32_t recv_next = 0; //stream offset of the next byte expected from the peer
+		bool ack_pending = false; //received reliable data that hasn't been acknowledged yet
+		std::chrono::steady_clock::time_point retransmit_at; //when to resend unacknowledged data
+
+		//unreliable channel:
+		uint32_t unreliable_send_seq = 0; //sequence number of the next outgoing unreliable message
+		uint32_t unreliable_recv_seq = 0; //sequence number of the newest unreliable message received
+		bool got_unreliable = false;
+		uint32_t stale_dropped = 0; //unreliable messages discarded because a newer one had already arrived
+
+		std::chrono::steady_clock::time_point last_send; //(for keep-alives)
+		std::chrono::steady_clock::time_point last_recv; //(for timeouts)
+	};
+	std::unique_ptr< Datagram > datagram;
 
 	enum Event {
 		OnOpen,
@@ -100,7 +236,11 @@ struct Connection {
 };
 
 struct Server {
-	Server(std::string const &port); //pass the port number to listen on, as a string (servname, really)
+	Server(std::string const &port, PollBackend backend = PollBackend::Select, bool share_port = false, Transport transport = Transport::Stream); //pass the port number to listen on, as a string (servname, really)
+	//  share_port: allow several Servers (e.g., one per thread) to listen on the same port; the OS spreads new connections among them (linux only)
+	//  transport: with Transport::Datagram, 'listen_socket' is a UDP socket and each remote address gets its own Connection
+	~Server();
+	Server(Server const &) = delete;
 
 	//poll() updates the list of active connections and sends/receives data if possible:
 	// (will wait up to 'timeout' for first event)
@@ -109,13 +249,25 @@ struct Server {
 		double timeout = 0.0 //timeout (seconds)
 	);
 
+	//(epoll backend) also end poll()'s wait when 'fd' becomes readable -- e.g., a timerfd (see TickScheduler):
+	// poll() doesn't read from it, so the caller must (or later polls won't wait at all)
+	void add_wakeup(int fd);
+
 	std::list< Connection > connections;
 	Socket listen_socket = InvalidSocket;
+
+	PollBackend backend;
+	int epoll_fd = -1; //(epoll backend) instance all sockets are registered with
+
+	Transport transport;
+	std::unordered_map< std::string, Connection * > datagram_peers; //(datagram transport) peer address => connection
 };
 
 
 struct Client {
-	Client(std::string const &host, std::string const &port);
+	Client(std::string const &host, std::string const &port, PollBackend backend = PollBackend::Select, Transport transport = Transport::Stream);
+	~Client();
+	Client(Client const &) = delete;
 
 	//poll() checks the status of the active connection and sends/receives data if possible:
 	// (will wait up to 'timeout' for first event)
@@ -126,4 +278,9 @@ struct Client {
 
 	std::list< Connection > connections; //will only ever contain exactly one connection
 	Connection &connection; //reference to the only connection in the connections list
+
+	PollBackend backend;
+	int epoll_fd = -1; //(epoll backend) instance the connection's socket is registered with
+
+	Transport transport;
 };
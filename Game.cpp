@@ -1,106 +1,290 @@
 #include "Game.hpp"
 
 #include "Connection.hpp"
+#include "BitPack.hpp"
 
 #include <stdexcept>
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <bit>
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/norm.hpp>
 
-void Player::Controls::send_controls_message(Connection *connection_) const
+void Player::Controls::send_controls_message(Connection *connection_)
 {
 	assert(connection_);
 	auto &connection = *connection_;
 
-	uint32_t size = 2;
-	connection.send(Message::C2S_Controls);
-	connection.send(uint8_t(size));
-	connection.send(uint8_t(size >> 8));
-	connection.send(uint8_t(size >> 16));
+	// remember this frame's input (newest first):
+	for (uint32_t i = Redundancy - 1; i > 0; --i)
+	{
+		sent[i] = sent[i - 1];
+	}
+	sent[0].seq = seq;
+	sent[0].tick = tick;
+	sent[0].up = up;
+	sent[0].down = down;
+	sent_count = std::min(sent_count + 1, Redundancy);
+
+	// message: [type, size (24 bits), newest seq, newest tick, count, count x [up, down, ticks before newest]]
+	static thread_local uint8_t message[MessageHeaderSize + 4 + 4 + 1 + 3 * Redundancy];
+	BufferWriter writer(message);
+	writer.begin(Message::C2S_Controls);
+	writer.write(seq);
+	writer.write(tick);
+	writer.write(uint8_t(sent_count));
 
-	auto send_button = [&](Button const &b)
+	auto button_byte = [&](Button const &b)
 	{
 		if (b.downs & 0x80)
 		{
 			std::cerr << "Wow, you are really good at pressing buttons!" << std::endl;
 		}
-		connection.send(uint8_t((b.pressed ? 0x80 : 0x00) | (b.downs & 0x7f)));
+		return uint8_t((b.pressed ? 0x80 : 0x00) | (b.downs & 0x7f));
 	};
 
-	send_button(up);
-	send_button(down);
+	for (uint32_t i = 0; i < sent_count; ++i)
+	{
+		writer.write(button_byte(sent[i].up));
+		writer.write(button_byte(sent[i].down));
+		uint32_t before = (tick >= sent[i].tick ? tick - sent[i].tick : 0);
+		writer.write(uint8_t(std::min(before, 255u)));
+	}
+	writer.finish();
+
+	// a lost message is covered by the repeats in the next few, so it can go unreliably:
+	connection.send_unreliable(writer.data(), writer.size(), nullptr);
 }
 
-bool Player::Controls::recv_controls_message(Connection *connection_)
+// fold a later input's button into an earlier one: downs add up, and the later one says whether it is pressed now
+static void merge_button(Button const &from, Button *button)
 {
-	assert(connection_);
-	auto &connection = *connection_;
+	button->pressed = from.pressed;
+	uint32_t d = uint32_t(button->downs) + uint32_t(from.downs);
+	if (d > 255)
+	{
+		std::cerr << "got a whole lot of downs" << std::endl;
+		d = 255;
+	}
+	button->downs = uint8_t(d);
+}
 
-	auto &recv_buffer = connection.recv_buffer;
+void Player::Controls::recv_controls_message(MessageView const &message, uint32_t current_tick)
+{
+	uint32_t newest_seq = message.read< uint32_t >(0);
+	uint32_t newest_tick = message.read< uint32_t >(4);
+	uint32_t count = message[8];
+	if (count == 0 || message.size != 4 + 4 + 1 + 3 * count)
+		throw std::runtime_error("Controls message with size " + std::to_string(message.size) + " doesn't match its " + std::to_string(count) + " inputs!");
 
-	// expecting [type, size_low0, size_mid8, size_high8]:
-	if (recv_buffer.size() < 4)
-		return false;
-	if (recv_buffer[0] != uint8_t(Message::C2S_Controls))
-		return false;
-	uint32_t size = (uint32_t(recv_buffer[3]) << 16) | (uint32_t(recv_buffer[2]) << 8) | uint32_t(recv_buffer[1]);
-	if (size != 2)
-		throw std::runtime_error("Controls message with size " + std::to_string(size) + " != 5!");
+	// how long after the client's tick estimate its inputs show up (ignoring clients that don't know the tick yet):
+	if (newest_tick != 0 && newest_seq > received_seq && current_tick >= newest_tick && current_tick - newest_tick <= 4 * MaxInputDelay)
+	{
+		float sample = float(current_tick - newest_tick);
+		if (lag < 0.0f || sample > lag)
+			lag = sample;
+		else
+			lag += (sample - lag) * LagDecay;
+	}
 
-	// expecting complete message:
-	if (recv_buffer.size() < 4 + size)
-		return false;
+	auto read_button = [](uint8_t byte)
+	{
+		Button button;
+		button.pressed = (byte & 0x80);
+		button.downs = (byte & 0x7f);
+		return button;
+	};
 
-	auto recv_button = [](uint8_t byte, Button *button)
+	// queue inputs not seen before (oldest first):
+	for (uint32_t i = count; i > 0; --i)
 	{
-		button->pressed = (byte & 0x80);
-		uint32_t d = uint32_t(button->downs) + uint32_t(byte & 0x7f);
-		if (d > 255)
+		uint32_t index = i - 1;
+		if (newest_seq < index)
+			continue;
+		Input input;
+		input.seq = newest_seq - index;
+		if (input.seq <= received_seq)
+			continue;
+
+		input.up = read_button(message[9 + 3 * index + 0]);
+		input.down = read_button(message[9 + 3 * index + 1]);
+
+		// apply at the client's tick plus the usual lag, but never in the past, never too far ahead, and never before an earlier input:
+		input.tick = current_tick + 1;
+		if (newest_tick != 0 && lag >= 0.0f)
 		{
-			std::cerr << "got a whole lot of downs" << std::endl;
-			d = 255;
+			uint32_t made = newest_tick - std::min< uint32_t >(newest_tick, message[9 + 3 * index + 2]);
+			input.tick = std::max(input.tick, made + uint32_t(std::ceil(lag)));
 		}
-		button->downs = uint8_t(d);
-	};
+		input.tick = std::min(input.tick, current_tick + 1 + MaxInputDelay);
+		if (!pending.empty())
+			input.tick = std::max(input.tick, pending.back().tick);
+
+		// inputs landing on the same tick are merged, as apply_inputs would merge them -- so however fast a client sends,
+		//  there is at most one pending input per tick (and ticks go at most MaxInputDelay past the next one):
+		if (!pending.empty() && pending.back().tick == input.tick)
+		{
+			Input &merged = pending.back();
+			merge_button(input.up, &merged.up);
+			merge_button(input.down, &merged.down);
+			merged.seq = input.seq;
+		}
+		else
+		{
+			pending.emplace_back(input);
+		}
+		received_seq = input.seq;
+	}
+}
+
+void Player::Controls::apply_inputs(uint32_t tick)
+{
+	size_t applied = 0;
+	while (applied < pending.size() && pending[applied].tick <= tick)
+	{
+		Input const &input = pending[applied];
+		merge_button(input.up, &up);
+		merge_button(input.down, &down);
+		seq = input.seq;
+
+		++applied;
+	}
+	pending.erase(pending.begin(), pending.begin() + applied);
+}
+
+bool Player::frozen() const
+{
+	return (powerUps.mask & Game::FreezingPowerUps) != 0;
+}
+
+uint32_t PowerUpSet::size() const
+{
+	uint32_t total = 0;
+	for (uint8_t c : counts)
+		total += c;
+	return total;
+}
+
+bool PowerUpSet::add(PowerUp::Type type, uint32_t limit)
+{
+	if (counts[type] >= std::min(limit, 255u))
+		return false;
+	counts[type] += 1;
+	mask |= 1u << type;
+	return true;
+}
 
-	recv_button(recv_buffer[4 + 0], &up);
-	recv_button(recv_buffer[4 + 1], &down);
+bool PowerUpSet::remove_one(PowerUp::Type type)
+{
+	if (counts[type] == 0)
+		return false;
+	counts[type] -= 1;
+	if (counts[type] == 0)
+		mask &= ~(1u << type);
+	return true;
+}
+
+void PowerUpSet::clear()
+{
+	mask = 0;
+	counts.fill(0);
+}
+
+EffectTimers::EffectTimers()
+{
+	level0.fill(None);
+	level1.fill(None);
+	for (uint32_t i = 0; i < Capacity; ++i)
+		timers[i].next = uint8_t(i + 1 < Capacity ? i + 1 : None);
+	free_list = 0;
+}
 
-	// delete message from buffer:
-	recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
+bool EffectTimers::schedule(uint32_t delay, uint8_t player, PowerUp::Type type)
+{
+	if (free_list == None)
+		return false;
+	uint8_t index = free_list;
+	free_list = timers[index].next;
+	count += 1;
 
+	Timer &timer = timers[index];
+	timer.expires = now + std::clamp(delay, 1u, MaxDelay);
+	timer.player = player;
+	timer.type = uint8_t(type);
+	insert(index);
 	return true;
 }
 
-bool Player::hasPowerUp(PowerUp::Type powerUp)
+void EffectTimers::insert(uint8_t index)
 {
-	return std::find(powerUps.begin(), powerUps.end(), powerUp) != powerUps.end();
+	Timer &timer = timers[index];
+	uint8_t *slot;
+	if (timer.expires - now < Slots)
+		slot = &level0[timer.expires & (Slots - 1)];
+	else
+		slot = &level1[(timer.expires >> SlotBits) & (Slots - 1)];
+	timer.next = *slot;
+	*slot = index;
+}
+
+void EffectTimers::remove_player(uint8_t player)
+{
+	for (auto *levels : {&level0, &level1})
+	{
+		for (uint8_t &head : *levels)
+		{
+			uint8_t *link = &head;
+			while (*link != None)
+			{
+				Timer &timer = timers[*link];
+				if (timer.player == player)
+				{
+					uint8_t index = *link;
+					*link = timer.next;
+					timer.next = free_list;
+					free_list = index;
+					count -= 1;
+					continue;
+				}
+				if (timer.player > player)
+					timer.player -= 1;
+				link = &timer.next;
+			}
+		}
+	}
 }
 
 //-----------------------------------------
 
-Game::Game() { start_round(); }
+static uint64_t random_seed()
+{
+	std::random_device rd;
+	return (uint64_t(rd()) << 32) | uint64_t(rd());
+}
+
+Game::Game() : Game(random_seed()) {}
+
+Game::Game(uint64_t seed_) : seed(seed_), random(seed_) { start_round(); }
 
 void Game::start_round()
 {
 	// Set the ball's direction to a random direction
-	std::random_device rd;
-	std::mt19937 mt_dir(rd());
-	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
-
-	BallDirection.x = dist(mt_dir);
-	BallDirection.y = dist(mt_dir);
+	BallDirection.x = random.uniform(-1.0f, 1.0f);
+	BallDirection.y = random.uniform(-1.0f, 1.0f);
 
 	// Make sure the ball is not going straight up or down or doesn't move
 	while (BallDirection.x == 0.0f && (std::abs(BallDirection.y) == 1.0f || BallDirection.y == 0.0f))
 	{
-		BallDirection.x = dist(mt_dir);
-		BallDirection.y = dist(mt_dir);
+		BallDirection.x = random.uniform(-1.0f, 1.0f);
+		BallDirection.y = random.uniform(-1.0f, 1.0f);
 	};
 
-	BallDirection = glm::normalize(BallDirection);
+	// (by hand rather than glm::normalize, which may use a reciprocal square root estimate)
+	BallDirection = BallDirection / std::sqrt(BallDirection.x * BallDirection.x + BallDirection.y * BallDirection.y);
 	BallPosition = glm::vec2(0.0f, 0.0f);
 
 	currBallSpeed = BallSpeed;
@@ -124,6 +308,7 @@ void Game::remove_player(Player *player)
 	{
 		if (&*pi == player)
 		{
+			effect_timers.remove_player(player_index(player));
 			players.erase(pi);
 			found = true;
 			break;
@@ -144,15 +329,12 @@ void Game::update(float elapsed)
 			if (currPowerUpCooldown < 0)
 			{
 				currPowerUp.active = true;
-				std::random_device rd;
-				std::mt19937 mt_dir(rd());
-				std::uniform_real_distribution<float> dist(-0.8f, 0.8f);
 
-				currPowerUp.Position = glm::vec2(ArenaMax.x * dist(mt_dir), ArenaMax.y * dist(mt_dir));
+				float x = random.uniform(-0.8f, 0.8f);
+				float y = random.uniform(-0.8f, 0.8f);
+				currPowerUp.Position = glm::vec2(ArenaMax.x * x, ArenaMax.y * y);
 
-				std::uniform_int_distribution<int> dist_pu(0, PowerUp::TYPE_LENGTH - 1);
-
-				currPowerUp.type = static_cast<PowerUp::Type>(dist_pu(mt_dir));
+				currPowerUp.type = static_cast<PowerUp::Type>(random.below(PowerUp::TYPE_LENGTH));
 
 				currPowerUpCooldown = PowerUpCooldown;
 			}
@@ -161,266 +343,985 @@ void Game::update(float elapsed)
 		// position/velocity update for players:
 		for (auto &p : players)
 		{
-			if (!p.hasPowerUp(PowerUp::Freeze))
-			{
-				float dir = 0.0f;
-				if (p.controls.down.pressed)
-					dir -= 1.0f;
-				if (p.controls.up.pressed)
-					dir += 1.0f;
+			// (a frozen paddle stays put, and keeps its button presses for when it thaws)
+			if (p.frozen())
+				continue;
 
-				if (dir == 0.0f)
-				{
-					// no inputs: just drift to a stop
-					float amt = 1.0f - std::pow(0.5f, elapsed / (PlayerAccelHalflife * 2.0f));
-					p.velocity = glm::mix(p.velocity, 0.0f, amt);
-				}
-				else
-				{
-					float amt = 1.0f - std::pow(0.5f, elapsed / PlayerAccelHalflife);
+			move_player(p, elapsed);
 
-					// accelerate along velocity (if not fast enough):
-					float along = dir * p.velocity;
-					if (along < PlayerSpeed)
-					{
-						along = glm::mix(along, PlayerSpeed, amt);
-					}
+			// reset 'downs' since controls have been handled:
+			p.controls.up.downs = 0;
+			p.controls.down.downs = 0;
+		}
 
-					p.velocity = dir * along;
-				}
-				p.position += p.velocity * elapsed;
+		// held power-ups that have run out:
+		auto expire = [this](uint8_t index, PowerUp::Type type)
+		{
+			assert(index < players.size());
+			expire_power_up(*std::next(players.begin(), index), index, type, &effect_timers, tick);
+		};
+		effect_timers.advance(expire);
 
-				// reset 'downs' since controls have been handled:
-				p.controls.up.downs = 0;
-				p.controls.down.downs = 0;
-			}
-			else
-			{
-				p.currFreezeTimer -= elapsed;
-				if (p.currFreezeTimer <= 0)
-				{
-					auto freeze = std::find(p.powerUps.begin(), p.powerUps.end(), PowerUp::Freeze);
-					p.powerUps.erase(freeze);
-					p.currFreezeTimer = Player::FreezeTimer;
-				}
-			}
-		}
+		// ball movement, one contact at a time (so a fast ball can't tunnel through anything, whatever the tick rate):
+		move_ball(elapsed);
+	}
+}
 
-		// position update for the ball:
+// Swept circle vs. axis-aligned box: earliest time in [0, max_t] at which a circle at 'p' moving at 'v' touches the box
+// (center 'c', half-size 'h') while moving into it. Sets *t and *normal (unit, pointing out of the box at the contact).
+// A circle that already overlaps the box doesn't count as a hit (see Game::move_ball).
+static bool sweep_circle_box(glm::vec2 p, glm::vec2 v, float r, glm::vec2 c, glm::vec2 h, float max_t, float *t, glm::vec2 *normal)
+{
+	glm::vec2 q = p - c;
+
+	// entry / exit times of the box grown by r (slab test):
+	float enter = -INFINITY, exit = INFINITY;
+	int enter_axis = 0;
+	for (int i = 0; i < 2; ++i)
+	{
+		float e = h[i] + r;
+		if (v[i] == 0.0f)
+		{
+			if (q[i] < -e || q[i] > e)
+				return false;
+			continue;
+		}
+		float t0 = (-e - q[i]) / v[i];
+		float t1 = (e - q[i]) / v[i];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		if (t0 > enter)
 		{
-			prevBallPosition = BallPosition;
-			BallPosition += BallDirection * currBallSpeed * elapsed;
+			enter = t0;
+			enter_axis = i;
 		}
+		exit = std::min(exit, t1);
+	}
+	if (enter > exit || enter < 0.0f || enter > max_t)
+		return false;
 
-		// collision resolution:
-		for (auto &p : players)
+	glm::vec2 at = q + v * enter;
+	if (std::abs(at.x) > h.x && std::abs(at.y) > h.y)
+	{
+		// in a corner of the grown box, which is really rounded -- hit the circle around that corner instead:
+		glm::vec2 corner = glm::vec2(std::copysign(h.x, at.x), std::copysign(h.y, at.y));
+		glm::vec2 d = q - corner;
+		float a = v.x * v.x + v.y * v.y;
+		float b = d.x * v.x + d.y * v.y;
+		float cc = d.x * d.x + d.y * d.y - r * r;
+		float disc = b * b - a * cc;
+		if (disc < 0.0f || b >= 0.0f)
+			return false;
+		float hit = (-b - std::sqrt(disc)) / a;
+		if (hit < 0.0f || hit > max_t)
+			return false;
+		glm::vec2 n = d + v * hit;
+		*t = hit;
+		*normal = n / std::sqrt(n.x * n.x + n.y * n.y);
+		return true;
+	}
+
+	glm::vec2 n = glm::vec2(0.0f);
+	n[enter_axis] = (v[enter_axis] > 0.0f ? -1.0f : 1.0f);
+	*t = enter;
+	*normal = n;
+	return true;
+}
+
+// does a circle at 'p' overlap the box (center 'c', half-size 'h')?
+static bool circle_overlaps_box(glm::vec2 p, float r, glm::vec2 c, glm::vec2 h)
+{
+	glm::vec2 d = p - glm::clamp(p, c - h, c + h);
+	return d.x * d.x + d.y * d.y < r * r;
+}
+
+void Game::move_ball(float elapsed)
+{
+	prevBallPosition = BallPosition;
+
+	// the paddles (the one the ball is heading for is the receiving player's):
+	struct Paddle
+	{
+		Player *player;
+		glm::vec2 center;
+	};
+	std::array<Paddle, 2> paddles{{
+		{&players.front(), glm::vec2(-PlayerXPos, players.front().position)},
+		{&players.back(), glm::vec2(PlayerXPos, players.back().position)},
+	}};
+	glm::vec2 const PaddleSize = glm::vec2(PlayerWidth, PlayerHeight);
+
+	auto reflect = [&](glm::vec2 normal)
+	{
+		float along = BallDirection.x * normal.x + BallDirection.y * normal.y;
+		if (along < 0.0f)
+			BallDirection -= 2.0f * along * normal;
+	};
+
+	// paddles move first, so one may have moved onto the ball -- push it out the way the paddle came:
+	for (auto const &paddle : paddles)
+	{
+		if (!circle_overlaps_box(BallPosition, BallRadius, paddle.center, PaddleSize))
+			continue;
+		float side = (BallPosition.y >= paddle.center.y ? 1.0f : -1.0f);
+		BallPosition.y = paddle.center.y + side * (PlayerHeight + BallRadius);
+		reflect(glm::vec2(0.0f, side));
+		sounds_to_play |= 1 << Sounds::Paddle;
+	}
+
+	// the power-up pad may have appeared on top of the ball:
+	if (currPowerUp.active && circle_overlaps_box(BallPosition, BallRadius, currPowerUp.Position, PowerUpPadSize))
+		collect_power_up();
+
+	float const Top = ArenaMax.y - WallThickness - BallRadius;
+	float const Bottom = ArenaMin.y + WallThickness + BallRadius;
+	float const Right = ArenaMax.x - WallThickness - BallRadius;
+	float const Left = ArenaMin.x + WallThickness + BallRadius;
+
+	float remaining = elapsed;
+	for (uint32_t step = 0; step < MaxBallSteps && remaining > 0.0f; ++step)
+	{
+		glm::vec2 velocity = BallDirection * currBallSpeed;
+
+		// find the first thing the ball touches before the tick is over:
+		enum
+		{
+			Nothing,
+			Wall,
+			Goal,
+			PaddleHit,
+			Pad
+		} hit = Nothing;
+		float t = remaining;
+		glm::vec2 normal = glm::vec2(0.0f);
+
+		auto wall = [&](float distance, float speed, glm::vec2 n, decltype(hit) what)
+		{
+			if (speed <= 0.0f)
+				return;
+			float when = std::max(0.0f, distance / speed);
+			if (when <= t)
+			{
+				t = when;
+				normal = n;
+				hit = what;
+			}
+		};
+		wall(Top - BallPosition.y, velocity.y, glm::vec2(0.0f, -1.0f), Wall);
+		wall(BallPosition.y - Bottom, -velocity.y, glm::vec2(0.0f, 1.0f), Wall);
+		wall(Right - BallPosition.x, velocity.x, glm::vec2(-1.0f, 0.0f), Goal);
+		wall(BallPosition.x - Left, -velocity.x, glm::vec2(1.0f, 0.0f), Goal);
+
+		for (auto const &paddle : paddles)
 		{
-			if (p.position - PlayerHeight < ArenaMin.y)
+			float when;
+			glm::vec2 n;
+			if (sweep_circle_box(BallPosition, velocity, BallRadius, paddle.center, PaddleSize, t, &when, &n))
 			{
-				p.position = ArenaMin.y + PlayerHeight;
+				t = when;
+				normal = n;
+				hit = PaddleHit;
 			}
-			if (p.position + PlayerHeight > ArenaMax.y)
+		}
+
+		if (currPowerUp.active)
+		{
+			float when;
+			glm::vec2 n;
+			if (sweep_circle_box(BallPosition, velocity, BallRadius, currPowerUp.Position, PowerUpPadSize, t, &when, &n))
 			{
-				p.position = ArenaMax.y - PlayerHeight;
+				t = when;
+				hit = Pad;
 			}
 		}
 
-		Player &receivingPlayer = BallDirection.x < 0 ? players.front() : players.back();
-		Player &senderPlayer = BallDirection.x > 0 ? players.front() : players.back();
-		float playerSide = std::copysignf(1.0f, BallDirection.x);
+		// move up to it:
+		BallPosition += velocity * t;
+		remaining -= t;
 
-		// Ball collision with the walls
-		if (BallPosition.y - BallRadius < ArenaMin.y + WallThickness || BallPosition.y + BallRadius > ArenaMax.y - WallThickness)
+		// and respond:
+		if (hit == Wall)
 		{
 			sounds_to_play |= 1 << Sounds::Wall;
-			BallDirection.y = -BallDirection.y;
+			reflect(normal);
+		}
+		else if (hit == PaddleHit)
+		{
+			sounds_to_play |= 1 << Sounds::Paddle;
+			reflect(normal);
 		}
-		if (BallPosition.x - BallRadius < ArenaMin.x + WallThickness || BallPosition.x + BallRadius > ArenaMax.x - WallThickness)
+		else if (hit == Pad)
 		{
-			// Only score if the receiving player doesn't have an extra life
-			if (!receivingPlayer.hasPowerUp(PowerUp::Type::ExtraLife))
+			// (the ball goes right over the pad)
+			collect_power_up();
+		}
+		else if (hit == Goal)
+		{
+			Player &receivingPlayer = BallDirection.x < 0 ? players.front() : players.back();
+			Player &senderPlayer = BallDirection.x > 0 ? players.front() : players.back();
+
+			// Only score if the receiving player doesn't hold something that saves the goal (an extra life)
+			uint32_t saves = receivingPlayer.powerUps.mask & GoalSavingPowerUps;
+			if (!saves)
 			{
 				sounds_to_play |= 1 << Sounds::Score;
 				senderPlayer.score++;
 				start_round();
+				break;
 			}
 			else
 			{
 				sounds_to_play |= 1 << Sounds::Wall;
 
-				auto extraLifePowerUp = std::find(receivingPlayer.powerUps.begin(), receivingPlayer.powerUps.end(), PowerUp::ExtraLife);
-				receivingPlayer.powerUps.erase(extraLifePowerUp);
-				BallDirection.x = -BallDirection.x;
+				// (the lowest-numbered one gets used up)
+				receivingPlayer.powerUps.remove_one(static_cast<PowerUp::Type>(std::countr_zero(saves)));
+				reflect(normal);
 			}
 		}
+	}
+}
 
-		// Ball collision with power up pad
-		if (currPowerUp.active)
+void Game::collect_power_up()
+{
+	Player &receivingPlayer = BallDirection.x < 0 ? players.front() : players.back();
+	Player &senderPlayer = BallDirection.x > 0 ? players.front() : players.back();
+
+	currPowerUp.active = false;
+	sounds_to_play |= 1 << Sounds::PowerUpSound;
+
+	PowerUpEffect const &effect = PowerUpEffects[currPowerUp.type];
+	if (effect.target == PowerUpEffect::Ball)
+		currBallSpeed *= effect.ball_speed_factor;
+	else
+	{
+		Player &player = (effect.target == PowerUpEffect::Receiver ? receivingPlayer : senderPlayer);
+		gain_power_up(player, player_index(&player), currPowerUp.type, &effect_timers, tick);
+	}
+}
+
+void Game::gain_power_up(Player &player, uint8_t index, PowerUp::Type type, EffectTimers *timers, float tick)
+{
+	assert(timers);
+	PowerUpEffect const &effect = PowerUpEffects[type];
+	bool first = !player.powerUps.contains(type);
+	if (!player.powerUps.add(type, effect.max_stack))
+		return;
+
+	// timed ones run out one after another, so only the first one held needs a timer (see expire_power_up):
+	if (effect.duration != 0.0f && first)
+	{
+		if (!timers->schedule(effect.duration_ticks(tick), index, type))
+			player.powerUps.remove_one(type); // (no timer left to end it -- as if it was never collected)
+	}
+}
+
+void Game::expire_power_up(Player &player, uint8_t index, PowerUp::Type type, EffectTimers *timers, float tick)
+{
+	assert(timers);
+	player.powerUps.remove_one(type);
+	if (player.powerUps.contains(type))
+		timers->schedule(PowerUpEffects[type].duration_ticks(tick), index, type);
+}
+
+float Game::halflife_decay(float elapsed, float halflife)
+{
+	float x = -elapsed / halflife;
+	if (!(x > -126.0f))
+		return 0.0f;
+	// 2^x = 2^n * 2^f with f in [-0.5, 0.5], and 2^f from its Taylor series (good to float precision on that range):
+	float n = std::round(x);
+	float f = (x - n) * 0.69314718f;
+	float p = 1.0f + f * (1.0f + f * (1.0f / 2.0f + f * (1.0f / 6.0f + f * (1.0f / 24.0f + f * (1.0f / 120.0f + f * (1.0f / 720.0f + f * (1.0f / 5040.0f)))))));
+	return std::ldexp(p, int(n));
+}
+
+void Game::move_player(Player &p, float elapsed)
+{
+	float dir = 0.0f;
+	if (p.controls.down.pressed)
+		dir -= 1.0f;
+	if (p.controls.up.pressed)
+		dir += 1.0f;
+
+	if (dir == 0.0f)
+	{
+		// no inputs: just drift to a stop
+		float amt = 1.0f - halflife_decay(elapsed, PlayerAccelHalflife * 2.0f);
+		p.velocity = p.velocity * (1.0f - amt);
+	}
+	else
+	{
+		float amt = 1.0f - halflife_decay(elapsed, PlayerAccelHalflife);
+
+		// accelerate along velocity (if not fast enough):
+		float along = dir * p.velocity;
+		if (along < PlayerSpeed)
 		{
-			if (BallPosition.y - BallRadius < currPowerUp.Position.y + PowerUpPadSize.y &&
-				BallPosition.y + BallRadius > currPowerUp.Position.y - PowerUpPadSize.y &&
-				BallPosition.x + playerSide * BallRadius > currPowerUp.Position.x - PowerUpPadSize.x &&
-				BallPosition.x + playerSide * BallRadius < currPowerUp.Position.x + PowerUpPadSize.x)
-			{
-				currPowerUp.active = false;
-				sounds_to_play |= 1 << Sounds::PowerUpSound;
-
-				if (currPowerUp.type == PowerUp::SpeedUp)
-					currBallSpeed *= BallSpeedUpFactor;
-				else if (currPowerUp.type == PowerUp::Freeze)
-					receivingPlayer.powerUps.push_back(currPowerUp.type);
-				else
-					senderPlayer.powerUps.push_back(currPowerUp.type);
-			}
+			// (glm::mix, spelled out so GameBatch can do exactly the same arithmetic)
+			along = along * (1.0f - amt) + PlayerSpeed * amt;
 		}
 
-		// Ball collision with the paddles
+		p.velocity = dir * along;
+	}
+	p.position += p.velocity * elapsed;
+
+	// keep the paddle in the arena:
+	if (p.position - PlayerHeight < ArenaMin.y)
+	{
+		p.position = ArenaMin.y + PlayerHeight;
+	}
+	if (p.position + PlayerHeight > ArenaMax.y)
+	{
+		p.position = ArenaMax.y - PlayerHeight;
+	}
+}
+
+void Game::save(Frame *frame_) const
+{
+	assert(frame_);
+	Frame &frame = *frame_;
+
+	if (players.size() > Frame::MaxPlayers)
+		throw std::runtime_error("Can't save a game with " + std::to_string(players.size()) + " players.");
+	frame.player_count = uint8_t(players.size());
+	auto out = frame.players.begin();
+	for (auto const &p : players)
+	{
+		out->up = p.controls.up;
+		out->down = p.controls.down;
+		out->position = p.position;
+		out->velocity = p.velocity;
+		out->score = p.score;
+		out->power_ups = p.powerUps;
+		++out;
+	}
+
+	frame.ball_position = BallPosition;
+	frame.ball_direction = BallDirection;
+	frame.prev_ball_position = prevBallPosition;
+	frame.ball_speed = currBallSpeed;
+	frame.power_up = currPowerUp;
+	frame.power_up_cooldown = currPowerUpCooldown;
+	frame.effect_timers = effect_timers;
+	frame.random_state = random.state;
+	frame.sounds_to_play = sounds_to_play;
+}
+
+void Game::restore(Frame const &frame)
+{
+	if (players.size() != frame.player_count)
+		throw std::runtime_error("Can't restore a " + std::to_string(frame.player_count) + "-player frame into a game with " + std::to_string(players.size()) + " players.");
+	auto in = frame.players.begin();
+	for (auto &p : players)
+	{
+		p.controls.up = in->up;
+		p.controls.down = in->down;
+		p.position = in->position;
+		p.velocity = in->velocity;
+		p.score = in->score;
+		p.powerUps = in->power_ups;
+		++in;
+	}
+
+	BallPosition = frame.ball_position;
+	BallDirection = frame.ball_direction;
+	prevBallPosition = frame.prev_ball_position;
+	currBallSpeed = frame.ball_speed;
+	currPowerUp = frame.power_up;
+	currPowerUpCooldown = frame.power_up_cooldown;
+	effect_timers = frame.effect_timers;
+	random.state = frame.random_state;
+	sounds_to_play = frame.sounds_to_play;
+}
+
+uint64_t Game::hash() const
+{
+	uint64_t h = 0xcbf29ce484222325ull;
+	auto add = [&](auto const &val)
+	{
+		uint8_t bytes[sizeof(val)];
+		std::memcpy(bytes, &val, sizeof(val));
+		for (uint8_t b : bytes)
 		{
-			if (BallPosition.y - BallRadius < receivingPlayer.position + PlayerHeight &&
-				BallPosition.y + BallRadius > receivingPlayer.position - PlayerHeight &&
-				BallPosition.x + playerSide * BallRadius > playerSide * PlayerXPos - PlayerWidth &&
-				BallPosition.x + playerSide * BallRadius < playerSide * PlayerXPos + PlayerWidth)
-			{
-				// Bounce off the side
-				if (prevBallPosition.x + playerSide * BallRadius < playerSide * PlayerXPos - PlayerWidth ||
-					prevBallPosition.x + playerSide * BallRadius > playerSide * PlayerXPos + PlayerWidth)
-				{
-					BallDirection.x = -BallDirection.x;
-					// BallDirection.y += receivingPlayer.velocity * FrictionFactor;
-					sounds_to_play |= 1 << Sounds::Paddle;
-				}
+			h = (h ^ b) * 0x100000001b3ull;
+		}
+	};
+	auto add_button = [&](Button const &button)
+	{
+		add(button.downs);
+		add(uint8_t(button.pressed));
+	};
 
-				// Bounce off the top/bottom
-				if ((prevBallPosition.y - BallRadius > receivingPlayer.position + PlayerHeight ||
-					 prevBallPosition.y + BallRadius < receivingPlayer.position - PlayerHeight))
-				{
-					BallDirection.y = -BallDirection.y;
-					sounds_to_play |= 1 << Sounds::Paddle;
-				}
-			}
+	add(uint32_t(players.size()));
+	for (auto const &p : players)
+	{
+		add_button(p.controls.up);
+		add_button(p.controls.down);
+		add(p.position);
+		add(p.velocity);
+		add(p.score);
+		add(p.powerUps.mask);
+		add(p.powerUps.counts);
+	}
+
+	add(BallPosition.x);
+	add(BallPosition.y);
+	add(BallDirection.x);
+	add(BallDirection.y);
+	add(prevBallPosition.x);
+	add(prevBallPosition.y);
+	add(currBallSpeed);
+
+	add(uint32_t(currPowerUp.type));
+	add(uint8_t(currPowerUp.active));
+	add(currPowerUp.Position.x);
+	add(currPowerUp.Position.y);
+	add(currPowerUpCooldown);
+
+	add(effect_timers.now);
+	add(uint32_t(effect_timers.count));
+	auto add_timer = [&](EffectTimers::Timer const &timer)
+	{
+		add(timer.expires);
+		add(timer.player);
+		add(timer.type);
+	};
+	effect_timers.for_each(add_timer);
+
+	add(random.state);
+	add(sounds_to_play);
+
+	return h;
+}
+
+uint8_t Game::player_index(Player const *player) const
+{
+	uint8_t index = 0;
+	for (auto const &p : players)
+	{
+		if (&p == player)
+			return index;
+		++index;
+	}
+	return NoPlayer;
+}
+
+void Game::take_snapshot()
+{
+	state_seq += 1;
+	StateSlot &slot = state_history[state_seq % StateHistory];
+	slot.seq = state_seq;
+	slot.payloads = {};
+
+	// Sounds go out with this snapshot
+	snapshot_sounds = sounds_to_play;
+	slot.sounds = snapshot_sounds;
+	sounds_to_play = 0;
+}
+
+uint8_t Game::sounds_since(uint32_t seq) const
+{
+	uint8_t sounds = 0;
+	uint32_t oldest = (state_seq > StateHistory ? state_seq - StateHistory + 1 : 1);
+	for (uint32_t s = std::max(seq + 1, oldest); s < state_seq; ++s)
+	{
+		StateSlot const &slot = state_history[s % StateHistory];
+		if (slot.seq == s)
+			sounds |= slot.sounds;
+	}
+	return sounds;
+}
+
+SharedBytes Game::encode_state(StateEncoding encoding)
+{
+	assert(state_seq != 0 && "call take_snapshot() before encode_state()");
+	StateSlot &slot = state_history[state_seq % StateHistory];
+	assert(slot.seq == state_seq);
+
+	SharedBytes &payload = slot.payloads[size_t(encoding)];
+	if (!payload)
+	{
+		auto state = take_payload_buffer();
+		if (encoding == StateEncoding::Packed)
+			encode_state_packed(state.get());
+		else
+			encode_state_raw(state.get());
+		payload = state;
+	}
+	return payload;
+}
+
+std::shared_ptr<std::vector<uint8_t>> Game::take_payload_buffer()
+{
+	// a buffer only the pool holds is free (everything else that held it -- history slots, send queues -- has let go):
+	for (size_t i = 0; i < payload_pool.size(); ++i)
+	{
+		auto &buffer = payload_pool[(payload_pool_next + i) % payload_pool.size()];
+		if (buffer.use_count() == 1)
+		{
+			payload_pool_next = (payload_pool_next + i + 1) % payload_pool.size();
+			buffer->clear();
+			return buffer;
 		}
 	}
+	payload_pool.emplace_back(std::make_shared<std::vector<uint8_t>>());
+	// (room for any snapshot up front, so a payload growing a little later doesn't mean growing every buffer in turn)
+	payload_pool.back()->reserve(PayloadReserve);
+	return payload_pool.back();
 }
 
-void Game::send_state_message(Connection *connection_, Player *connection_player)
+void Game::encode_state_raw(std::vector<uint8_t> *state) const
 {
-	assert(connection_);
-	auto &connection = *connection_;
+	assert(state);
 
-	connection.send(Message::S2C_State);
-	// will patch message size in later, for now placeholder bytes:
-	connection.send(uint8_t(0));
-	connection.send(uint8_t(0));
-	connection.send(uint8_t(0));
-	size_t mark = connection.send_buffer.size(); // keep track of this position in the buffer
+	// append raw bytes of any value:
+	auto send = [&](auto const &val)
+	{
+		uint8_t const *bytes = reinterpret_cast<uint8_t const *>(&val);
+		state->insert(state->end(), bytes, bytes + sizeof(val));
+	};
 
 	// send player info helper:
 	auto send_player = [&](Player const &player)
 	{
-		connection.send(player.position);
-		connection.send(player.score);
-		connection.send(player.powerUps.size());
-		std::cout.flush();
-		if (player.powerUps.size() > 0)
+		send(player.position);
+		send(player.score);
+		send(size_t(player.powerUps.size()));
+		for (uint32_t p = 0; p < PowerUp::TYPE_LENGTH; ++p)
 		{
-			std::cout << "Sent: " << player.powerUps.size() << std::endl;
-			for (PowerUp::Type powerUp : player.powerUps)
-			{
-				std::cout << "Sending: " << powerUp << std::endl;
-				connection.send(static_cast<int>(powerUp));
-			}
+			for (uint32_t n = 0; n < player.powerUps.counts[p]; ++n)
+				send(static_cast<int>(p));
 		}
 	};
 
 	// player count:
-	connection.send(uint8_t(players.size()));
-	if (connection_player)
-		send_player(*connection_player);
+	send(uint8_t(players.size()));
 	for (auto const &player : players)
 	{
-		if (&player == connection_player)
-			continue;
 		send_player(player);
 	}
 
-	connection.send(BallPosition);
-	connection.send(currPowerUp.active);
-	connection.send(currPowerUp.Position);
-	connection.send(sounds_to_play);
+	send(BallPosition);
+	send(currPowerUp.active);
+	send(currPowerUp.Position);
+}
 
-	// Reset sounds
-	sounds_to_play = 0;
+uint32_t Game::quantize(float value, float min, float max, uint32_t steps)
+{
+	float t = (value - min) / (max - min);
+	if (!(t > 0.0f))
+		t = 0.0f; // (also catches NaN)
+	if (t > 1.0f)
+		t = 1.0f;
+	return uint32_t(std::round(t * float(steps)));
+}
+
+float Game::dequantize(uint32_t q, float min, float max, uint32_t steps)
+{
+	if (q > steps)
+		throw std::runtime_error("Quantized position out of range.");
+	return min + (max - min) * (float(q) / float(steps));
+}
+
+// packed layout:
+//  [8 bits player count]
+//  per player: [BitsY position][varint score][PowerUp::TYPE_LENGTH bits power-up mask]
+//  [BitsX ball x][BitsY ball y]
+//  [1 bit power-up pad active] (if active: [BitsX pad x][BitsY pad y])
+// The power-up mask only says which power-ups a player holds, not how many of each.
+void Game::encode_state_packed(std::vector<uint8_t> *state) const
+{
+	assert(state);
+	BitWriter writer(*state);
+
+	auto write_x = [&](float x)
+	{
+		writer.write(quantize(x, ArenaMin.x, ArenaMax.x, StepsX), BitsX);
+	};
+	auto write_y = [&](float y)
+	{
+		writer.write(quantize(y, ArenaMin.y, ArenaMax.y, StepsY), BitsY);
+	};
 
-	// compute the message size and patch into the message header:
-	uint32_t size = uint32_t(connection.send_buffer.size() - mark);
-	connection.send_buffer[mark - 3] = uint8_t(size);
-	connection.send_buffer[mark - 2] = uint8_t(size >> 8);
-	connection.send_buffer[mark - 1] = uint8_t(size >> 16);
+	writer.write(uint32_t(players.size()), 8);
+	for (auto const &player : players)
+	{
+		write_y(player.position);
+		writer.write_varint(player.score);
+		writer.write(player.powerUps.mask, PowerUp::TYPE_LENGTH);
+	}
+
+	write_x(BallPosition.x);
+	write_y(BallPosition.y);
+
+	writer.write(currPowerUp.active ? 1 : 0, 1);
+	if (currPowerUp.active)
+	{
+		write_x(currPowerUp.Position.x);
+		write_y(currPowerUp.Position.y);
+	}
+}
+
+SharedBytes Game::find_state(uint32_t seq, StateEncoding encoding) const
+{
+	StateSlot const &slot = state_history[seq % StateHistory];
+	if (seq == 0 || slot.seq != seq)
+		return nullptr;
+	return slot.payloads[size_t(encoding)];
+}
+
+SharedBytes Game::encode_state_delta(uint32_t baseline, StateEncoding encoding)
+{
+	SharedBytes base = find_state(baseline, encoding);
+	if (!base)
+		return nullptr;
+	auto delta = take_payload_buffer();
+	delta_encode(*base, *encode_state(encoding), delta.get());
+	return delta;
 }
 
-bool Game::recv_state_message(Connection *connection_)
+void Game::delta_encode(std::vector<uint8_t> const &baseline, std::vector<uint8_t> const &state, std::vector<uint8_t> *delta)
+{
+	assert(delta);
+	delta->clear();
+
+	uint32_t size = uint32_t(state.size());
+	uint32_t words = (size + 3) / 4;
+	delta->reserve(5 + (words + 7) / 8 + size);
+	BitWriter(*delta).write_varint(size);
+
+	size_t mask_at = delta->size();
+	delta->resize(mask_at + (words + 7) / 8, 0);
+
+	for (uint32_t w = 0; w < words; ++w)
+	{
+		uint32_t begin = 4 * w;
+		uint32_t end = std::min(begin + 4, size);
+		bool changed = false;
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			uint8_t old = (i < baseline.size() ? baseline[i] : 0);
+			if (old != state[i])
+				changed = true;
+		}
+		if (changed)
+		{
+			(*delta)[mask_at + w / 8] |= uint8_t(1 << (w % 8));
+			delta->insert(delta->end(), state.begin() + begin, state.begin() + end);
+		}
+	}
+}
+
+void Game::delta_apply(std::vector<uint8_t> const &baseline, std::vector<uint8_t> const &delta, std::vector<uint8_t> *state)
+{
+	assert(state);
+	BitReader reader(delta);
+	uint32_t size = reader.read_varint();
+	if (size > 0xffffff)
+		throw std::runtime_error("State delta for a " + std::to_string(size) + "-byte payload is too large.");
+	uint32_t words = (size + 3) / 4;
+	size_t mask_at = reader.at / 8;
+	size_t at = mask_at + (words + 7) / 8;
+	if (at > delta.size())
+		throw std::runtime_error("State delta mask truncated.");
+
+	state->assign(size, uint8_t(0));
+	std::copy(baseline.begin(), baseline.begin() + std::min<size_t>(baseline.size(), size), state->begin());
+
+	for (uint32_t w = 0; w < words; ++w)
+	{
+		if (!(delta[mask_at + w / 8] & (1 << (w % 8))))
+			continue;
+		uint32_t begin = 4 * w;
+		uint32_t end = std::min(begin + 4, size);
+		if (at + (end - begin) > delta.size())
+			throw std::runtime_error("State delta words truncated.");
+		std::copy(delta.begin() + at, delta.begin() + at + (end - begin), state->begin() + begin);
+		at += end - begin;
+	}
+
+	if (at != delta.size())
+		throw std::runtime_error("Trailing data in state delta.");
+}
+
+void Game::send_state_message(Connection *connection_, SharedBytes const &state, Player const *connection_player, uint32_t baseline, StateEncoding encoding, uint8_t skipped_sounds) const
 {
 	assert(connection_);
 	auto &connection = *connection_;
-	auto &recv_buffer = connection.recv_buffer;
+	assert(state);
 
-	if (recv_buffer.size() < 4)
-		return false;
-	if (recv_buffer[0] != uint8_t(Message::S2C_State))
-		return false;
-	uint32_t size = (uint32_t(recv_buffer[3]) << 16) | (uint32_t(recv_buffer[2]) << 8) | uint32_t(recv_buffer[1]);
-	uint32_t at = 0;
-	// expecting complete message:
-	if (recv_buffer.size() < 4 + size)
-		return false;
+	uint8_t header[StateHeaderSize];
+	write_state_header(header, state->size(), connection_player, baseline, encoding, skipped_sounds);
+
+	// shared payload (a newer snapshot supersedes this one, so it can go unreliably -- and be dropped
+	// while the client isn't keeping up):
+	connection.send_unreliable(header, sizeof(header), state, /* droppable */ true);
+}
+
+void Game::write_state_header(uint8_t (&header)[StateHeaderSize], size_t payload_size, Player const *connection_player, uint32_t baseline, StateEncoding encoding, uint8_t skipped_sounds) const
+{
+	// per-connection header: [type, size (24 bits), index of connection's player, encoding, snapshot seq, baseline seq (0 if full), newest controls seq applied,
+	//  sounds since the previous snapshot sent to this connection]
+	// (sounds ride in the header rather than the payload, so a client can skip a stale snapshot without decoding it and still play them)
+	BufferWriter writer(header);
+	writer.begin(Message::S2C_State);
+	writer.write(player_index(connection_player));
+	writer.write(encoding);
+	writer.write(state_seq);
+	writer.write(baseline);
+	writer.write(connection_player ? connection_player->controls.seq : uint32_t(0));
+	writer.write(uint8_t(snapshot_sounds | skipped_sounds));
+	// (the payload itself is sent separately, after the header)
+	writer.finish(payload_size);
+	assert(writer.size() == StateHeaderSize);
+}
+
+void Game::send_state_message(Connection *connection, Player const *connection_player)
+{
+	take_snapshot();
+	send_state_message(connection, encode_state(), connection_player);
+}
+
+void Game::send_state_ack_message(Connection *connection_) const
+{
+	assert(connection_);
+	auto &connection = *connection_;
+
+	// only a snapshot in the requested encoding can serve as a baseline:
+	uint32_t seq = (find_state(state_seq, state_encoding) ? state_seq : 0);
+
+	// [type, size (24 bits), newest snapshot seq, encoding, snapshots per second]
+	uint8_t message[MessageHeaderSize + 4 + 1 + 1];
+	BufferWriter writer(message);
+	writer.begin(Message::C2S_StateAck);
+	writer.write(seq);
+	writer.write(state_encoding);
+	writer.write(state_send_rate);
+	writer.finish();
+	connection.send_raw(writer.data(), writer.size());
+}
+
+void Game::recv_state_ack_message(MessageView const &message, StateAck *ack)
+{
+	assert(ack);
+
+	if (message[4] >= StateEncodings)
+		throw std::runtime_error("State ack asks for unknown encoding " + std::to_string(message[4]) + ".");
+	ack->seq = message.read< uint32_t >(0);
+	ack->encoding = StateEncoding(message[4]);
+	ack->send_rate = message[5];
+}
+
+uint32_t Game::send_interval(uint8_t send_rate) const
+{
+	if (send_rate == 0)
+		return 1;
+	// (rounded to the nearest whole number of ticks)
+	return std::max(1u, uint32_t(1.0f / (tick * float(send_rate)) + 0.5f));
+}
+
+void Game::send_rates_message(Connection *connection_, uint32_t send_interval) const
+{
+	assert(connection_);
+	auto &connection = *connection_;
+
+	// [type, size (24 bits), tick (f32 seconds), ticks between snapshots (u16)]
+	uint8_t message[MessageHeaderSize + 4 + 2];
+	BufferWriter writer(message);
+	writer.begin(Message::S2C_Rates);
+	writer.write(tick);
+	writer.write(uint16_t(std::min(send_interval, 0xffffu)));
+	writer.finish();
+	connection.send_raw(writer.data(), writer.size());
+}
+
+void Game::recv_rates_message(MessageView const &message)
+{
+	float new_tick = message.read< float >(0);
+	uint16_t interval = message.read< uint16_t >(4);
+	if (!(new_tick > 0.0f && new_tick <= 1.0f) || interval == 0)
+		throw std::runtime_error("Rates message with tick " + std::to_string(new_tick) + " s and interval " + std::to_string(interval) + ".");
+	tick = new_tick;
+	state_send_interval = interval;
+}
+
+bool Game::recv_state_message(RingBuffer const &buffer, MessageView const &message)
+{
+	assert(message.type == Message::S2C_State);
 
-	// copy bytes from buffer and advance position:
+	// payload: [index of connection's player, encoding, snapshot seq, baseline seq, newest controls seq applied, sounds, state]
+	// (see write_state_header)
+	auto encoding_of = [](MessageView const &message)
+	{
+		if (message[1] >= StateEncodings)
+			throw std::runtime_error("State message in unknown encoding " + std::to_string(message[1]) + ".");
+		return StateEncoding(message[1]);
+	};
+
+	// When newer state messages are already waiting (the client hitched, or they arrived in one read), only the newest matters:
+	//  skip this one without decoding it, keeping just its sounds (which are in the header). Any other messages in between
+	//  stay where they are, to be handled in order.
+	// (a delta can only replace this one if its baseline is already in the history -- not if it is this one, or gone)
+	MessageView next;
+	for (size_t at = message.end; next.parse(buffer, at); at = next.end)
+	{
+		if (next.type != Message::S2C_State)
+			continue;
+		uint32_t next_baseline = next.read< uint32_t >(6);
+		if (next_baseline == 0 || find_state(next_baseline, encoding_of(next)))
+		{
+			// (added to any not yet played -- the client clears sounds_to_play once it has played them)
+			sounds_to_play |= message[14];
+			skipped_states += 1;
+			return false;
+		}
+	}
+
+	uint8_t index = message[0];
+	StateEncoding encoding = encoding_of(message);
+	uint32_t seq = message.read< uint32_t >(2);
+	uint32_t baseline = message.read< uint32_t >(6);
+	uint32_t input_seq = message.read< uint32_t >(10);
+	uint8_t sounds = message[14];
+	constexpr uint32_t Header = StateHeaderSize - MessageHeaderSize;
+
+	// (into a pooled buffer, since it stays in the history as a baseline)
+	auto state = take_payload_buffer();
+	if (baseline == 0)
+	{
+		state->resize(message.size - Header);
+		message.copy_out(Header, state->data(), state->size());
+	}
+	else
+	{
+		SharedBytes base = find_state(baseline, encoding);
+		if (!base)
+			throw std::runtime_error("State delta against snapshot " + std::to_string(baseline) + ", which is not in the history.");
+		recv_delta.reserve(PayloadReserve);
+		recv_delta.resize(message.size - Header);
+		message.copy_out(Header, recv_delta.data(), recv_delta.size());
+		delta_apply(*base, recv_delta, state.get());
+	}
+
+	decode_state(*state, encoding);
+	// (added to any not yet played -- the client clears sounds_to_play once it has played them)
+	sounds_to_play |= sounds;
+	local_player = index;
+	acked_input_seq = input_seq;
+
+	// remember it as a baseline for later deltas:
+	state_seq = seq;
+	StateSlot &slot = state_history[seq % StateHistory];
+	slot.seq = seq;
+	slot.payloads = {};
+	slot.payloads[size_t(encoding)] = state;
+
+	return true;
+}
+
+void Game::set_player_count(uint32_t count)
+{
+	while (players.size() > count)
+		spare_players.splice(spare_players.end(), players, std::prev(players.end()));
+	while (players.size() < count)
+	{
+		if (spare_players.empty())
+			players.emplace_back();
+		else
+			players.splice(players.end(), spare_players, std::prev(spare_players.end()));
+	}
+}
+
+void Game::decode_state(std::vector<uint8_t> const &state, StateEncoding encoding)
+{
+	if (encoding == StateEncoding::Packed)
+		decode_state_packed(state);
+	else
+		decode_state_raw(state);
+}
+
+void Game::decode_state_raw(std::vector<uint8_t> const &state)
+{
+	size_t at = 0;
+
+	// copy bytes from payload and advance position:
 	auto read = [&](auto *val)
 	{
-		if (at + sizeof(*val) > size)
+		if (at + sizeof(*val) > state.size())
 		{
 			throw std::runtime_error("Ran out of bytes reading state message.");
 		}
-		std::memcpy(val, &recv_buffer[4 + at], sizeof(*val));
+		std::memcpy(val, state.data() + at, sizeof(*val));
 		at += sizeof(*val);
 	};
 
-	players.clear();
 	uint8_t player_count;
 	read(&player_count);
-	for (uint8_t i = 0; i < player_count; ++i)
+	set_player_count(player_count);
+	for (auto &player : players)
 	{
-		players.emplace_back();
-		Player &player = players.back();
 		read(&player.position);
 		read(&player.score);
 		size_t powerUpsLength;
 		read(&powerUpsLength);
-		player.powerUps = {};
-		if (powerUpsLength > 0)
+		player.powerUps.clear();
+		for (size_t n = 0; n < powerUpsLength; ++n)
 		{
-			std::cout << "Received: " << powerUpsLength << std::endl;
-			std::cout.flush();
-			for (size_t n = 0; n < powerUpsLength; ++n)
-			{
-				int p;
-				read(&p);
-				std::cout << "Type: " << p << std::endl;
-				player.powerUps.emplace_back(static_cast<PowerUp::Type>(p));
-			}
+			int p;
+			read(&p);
+			if (p < 0 || p >= PowerUp::TYPE_LENGTH)
+				throw std::runtime_error("State message with a power-up of type " + std::to_string(p) + ".");
+			if (!player.powerUps.add(static_cast<PowerUp::Type>(p), 255))
+				throw std::runtime_error("State message with a player holding too many power-ups.");
 		}
 	}
 
 	read(&BallPosition);
 	read(&currPowerUp.active);
 	read(&currPowerUp.Position);
-	read(&sounds_to_play);
 
-	if (at != size)
+	if (at != state.size())
 		throw std::runtime_error("Trailing data in state message.");
+}
 
-	// delete message from buffer:
-	recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
+void Game::decode_state_packed(std::vector<uint8_t> const &state)
+{
+	BitReader reader(state);
 
-	return true;
+	auto read_x = [&]()
+	{
+		return dequantize(reader.read(BitsX), ArenaMin.x, ArenaMax.x, StepsX);
+	};
+	auto read_y = [&]()
+	{
+		return dequantize(reader.read(BitsY), ArenaMin.y, ArenaMax.y, StepsY);
+	};
+
+	set_player_count(reader.read(8));
+	for (auto &player : players)
+	{
+		player.position = read_y();
+		player.score = reader.read_varint();
+		// (the mask says which types are held, not how many -- so one of each)
+		uint32_t mask = reader.read(PowerUp::TYPE_LENGTH);
+		player.powerUps.clear();
+		for (uint32_t p = 0; p < PowerUp::TYPE_LENGTH; ++p)
+		{
+			if (mask & (1u << p))
+				player.powerUps.add(static_cast<PowerUp::Type>(p), 1);
+		}
+	}
+
+	BallPosition.x = read_x();
+	BallPosition.y = read_y();
+
+	currPowerUp.active = (reader.read(1) != 0);
+	if (currPowerUp.active)
+	{
+		currPowerUp.Position.x = read_x();
+		currPowerUp.Position.y = read_y();
+	}
+
+	if (!reader.finished())
+		throw std::runtime_error("Trailing data in packed state message.");
 }
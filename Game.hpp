@@ -1,21 +1,28 @@
 #pragma once
 
+#include "Message.hpp"
+
 #include <glm/glm.hpp>
 
 #include <string>
 #include <list>
-#include <random>
+#include <vector>
+#include <memory>
+#include <array>
+#include <bit>
 
 struct Connection;
+struct RingBuffer;
+typedef std::shared_ptr< std::vector< uint8_t > const > SharedBytes; //(matches Connection.hpp)
 
 //Game state, separate from rendering.
 
 //Currently set up for a "client sends controls" / "server sends whole state" situation.
 
-enum class Message : uint8_t {
-	C2S_Controls = 1, //Greg!
-	S2C_State = 's',
-	//...
+//how a state payload is serialized (each client picks one, see Game::send_state_ack_message):
+enum class StateEncoding : uint8_t {
+	Raw = 0, //in-memory bytes of each field (depends on the host's type sizes and endianness)
+	Packed = 1, //bit-packed: positions quantized to the arena, power-ups as a bitmask, varint scores
 };
 
 //used to represent a control input:
@@ -33,7 +40,7 @@ struct PowerUp {
 	};
 
 	// Type of the power up
-	Type type;
+	Type type = ExtraLife;
 
 	// Boolean indicating if the power up pad is currently on the arena
 	bool active = false;
@@ -42,35 +49,241 @@ struct PowerUp {
 	glm::vec2 Position = glm::vec2(0.0f, 0.0f);
 };
 
+//what a power-up does when collected -- one of these per PowerUp::Type, in Game::PowerUpEffects
+// (so a new power-up is a new row there, not a new special case in Game::update):
+struct PowerUpEffect {
+	//who gets it:
+	enum Target : uint8_t {
+		Sender, //the player who last hit the ball
+		Receiver, //the player the ball is heading for
+		Ball, //nobody holds it: it acts on the ball once, when collected
+	} target = Sender;
+
+	//how long a held one lasts, in seconds (0: until used up):
+	float duration = 0.0f;
+	//how many one player can hold (any more collected are lost) -- timed ones run out one after another:
+	uint8_t max_stack = 1;
+
+	//what holding one does:
+	bool freezes = false; //holder's paddle doesn't move
+	bool saves_goal = false; //a goal against the holder uses one up instead of scoring
+
+	//what it does to the ball (Target::Ball):
+	float ball_speed_factor = 1.0f;
+
+	//'duration' in ticks of 'tick' seconds (as EffectTimers counts it):
+	uint32_t duration_ticks(float tick) const { return uint32_t(duration / tick + 0.5f); }
+
+	//a bit (as in PowerUpSet::mask) for each type in 'effects' that has 'property':
+	template< size_t N >
+	static constexpr uint32_t mask_where(std::array< PowerUpEffect, N > const &effects, bool PowerUpEffect::*property) {
+		uint32_t mask = 0;
+		for (uint32_t t = 0; t < N; ++t) {
+			if (effects[t].*property) mask |= 1u << t;
+		}
+		return mask;
+	}
+};
+
+//power-ups held by a player: how many of each type, plus a bit per type held at all
+// (so "has it?" or "has anything that freezes?" is one test, whatever the number of types or players):
+struct PowerUpSet {
+	uint32_t mask = 0; //bit t: holds at least one of type t
+	std::array< uint8_t, PowerUp::TYPE_LENGTH > counts{};
+
+	bool contains(PowerUp::Type type) const { return (mask & (1u << type)) != 0; }
+	uint32_t count(PowerUp::Type type) const { return counts[type]; }
+	uint32_t size() const; //(all types)
+	bool empty() const { return mask == 0; }
+
+	//add one (returns false and drops it if 'limit' are held already):
+	bool add(PowerUp::Type type, uint32_t limit);
+	//remove one (returns false if there wasn't one):
+	bool remove_one(PowerUp::Type type);
+	void clear();
+
+	bool operator==(PowerUpSet const &other) const { return mask == other.mask && counts == other.counts; }
+};
+static_assert(PowerUp::TYPE_LENGTH <= 32, "PowerUpSet::mask has a bit per power-up type.");
+
+//when held power-ups run out, as a two-level hierarchical timer wheel counted in ticks:
+// level 0 has a slot for each of the next Slots ticks, level 1 a slot for each of the next Slots spans of Slots ticks
+// (emptied into level 0 as its span comes up). Scheduling a timer and advancing a tick are O(1), plus whatever fires.
+//Timers live in fixed storage, linked by index, so the whole wheel copies as plain data (see Game::Frame).
+struct EffectTimers {
+	inline static constexpr uint32_t SlotBits = 6;
+	inline static constexpr uint32_t Slots = 1u << SlotBits;
+	inline static constexpr uint32_t MaxDelay = Slots * (Slots - 1); //(ticks -- longer delays are clamped to this)
+	inline static constexpr uint32_t Capacity = 16;
+	inline static constexpr uint8_t None = 0xff;
+
+	struct Timer {
+		uint32_t expires = 0; //(tick)
+		uint8_t player = 0; //(index in Game::players)
+		uint8_t type = 0; //(PowerUp::Type)
+		uint8_t next = None; //(next timer in the same slot, or in the free list)
+	};
+	std::array< Timer, Capacity > timers;
+	std::array< uint8_t, Slots > level0, level1; //(first timer in each slot)
+	uint8_t free_list = 0; //(first unused timer)
+	uint8_t count = 0; //(timers scheduled)
+
+	//ticks advanced while any timer was scheduled (the wheel stands still while it's empty, so an idle wheel never changes):
+	uint32_t now = 0;
+
+	EffectTimers();
+
+	bool empty() const { return count == 0; }
+
+	//call expire(player, type) 'delay' ticks from now (returns false if the wheel is full):
+	bool schedule(uint32_t delay, uint8_t player, PowerUp::Type type);
+	//drop the timers of player 'index' and renumber those of later players (as when a player is removed):
+	void remove_player(uint8_t index);
+
+	//one tick: call expire(player, type) for each timer that runs out now:
+	template< typename Expire >
+	void advance(Expire &&expire);
+
+	//calls f(timer) for every scheduled timer, in a fixed order (for hashing):
+	template< typename F >
+	void for_each(F &&f) const;
+
+	//(internal) link timer 'index' into the slot for its expiry:
+	void insert(uint8_t index);
+};
+
+template< typename Expire >
+void EffectTimers::advance(Expire &&expire) {
+	if (count == 0) return;
+	now += 1;
+
+	//a new span of level 0: move the timers that expire in it down from level 1:
+	if ((now & (Slots - 1)) == 0) {
+		uint8_t index = level1[(now >> SlotBits) & (Slots - 1)];
+		level1[(now >> SlotBits) & (Slots - 1)] = None;
+		while (index != None) {
+			uint8_t next = timers[index].next;
+			insert(index);
+			index = next;
+		}
+	}
+
+	uint8_t &slot = level0[now & (Slots - 1)];
+	uint8_t index = slot;
+	slot = None;
+	while (index != None) {
+		Timer timer = timers[index];
+		//free it before calling expire() (which may schedule another in its place):
+		timers[index].next = free_list;
+		free_list = index;
+		count -= 1;
+		expire(timer.player, PowerUp::Type(timer.type));
+		index = timer.next;
+	}
+}
+
+template< typename F >
+void EffectTimers::for_each(F &&f) const {
+	for (auto const &levels : {&level0, &level1}) {
+		for (uint8_t head : *levels) {
+			for (uint8_t index = head; index != None; index = timers[index].next) {
+				f(timers[index]);
+			}
+		}
+	}
+}
+
 //state of one player in the game:
 struct Player {
 	//player inputs (sent from client):
 	struct Controls {
 		Button up, down;
 
-		void send_controls_message(Connection *connection) const;
-
-		//returns 'false' if no message or not a controls message,
-		//returns 'true' if read a controls message,
+		//sequence number of the newest input sent (client) / applied (server):
+		uint32_t seq = 0;
+		//(client) the client's estimate of the server's current tick when making this input (0 if unknown):
+		uint32_t tick = 0;
+
+		//one client frame's worth of input:
+		struct Input {
+			uint32_t seq = 0;
+			uint32_t tick = 0; //(client) tick estimate when made, (server) tick to apply it on
+			Button up, down;
+		};
+
+		//(client) the last few inputs sent, newest first -- every message repeats them in case earlier messages were lost:
+		inline static constexpr uint32_t Redundancy = 4;
+		std::array< Input, Redundancy > sent;
+		uint32_t sent_count = 0;
+
+		//record the current buttons as input 'seq' (made at 'tick') and send it along with the previous few:
+		void send_controls_message(Connection *connection);
+
+		//(server) inputs received but not yet applied, oldest first, at most one per tick (later inputs for a tick are merged in):
+		std::vector< Input > pending; //(erased from the front, so it keeps its capacity -- steady play never allocates)
+		uint32_t received_seq = 0; //newest input received (repeats of older ones are ignored)
+		float lag = -1.0f; //ticks from a client's tick estimate until its input has arrived (negative if unknown)
+		inline static constexpr uint32_t MaxInputDelay = 8; //(ticks an input can be held back at most)
+		inline static constexpr float LagDecay = 0.005f; //(per message; lag rises to a late arrival at once, falls back slowly)
+
+		//(server) handle a controls message, scheduling new inputs for ticks after 'current_tick' (see MessageDispatch):
 		//throws on malformed controls message
-		bool recv_controls_message(Connection *connection);
+		void recv_controls_message(MessageView const &message, uint32_t current_tick);
+
+		//apply the pending inputs scheduled on or before 'tick':
+		// (their downs add up, and the newest sets 'pressed' and 'seq')
+		void apply_inputs(uint32_t tick);
 	} controls;
 
 	// Power ups the player currently has
-	std::vector<PowerUp::Type> powerUps;
+	PowerUpSet powerUps;
 
-	bool hasPowerUp(PowerUp::Type powerUp);
+	bool hasPowerUp(PowerUp::Type powerUp) const { return powerUps.contains(powerUp); }
+	//holding anything that freezes the paddle?
+	bool frozen() const;
 
 	//player state (sent from server):
 	float position = 0.0f;
 	float velocity = 0.0f;
 
 	inline static constexpr float FreezeTimer = 1.0f;
-	float currFreezeTimer = FreezeTimer;
-	
+
 	uint32_t score = 0;
 };
 
+//Seeded random numbers for the simulation (PCG32):
+// unlike std::mt19937 + std:: distributions (whose mapping to ranges is implementation-defined),
+// the same seed gives the same values with any compiler or standard library.
+struct GameRandom {
+	uint64_t state = 0;
+	inline static constexpr uint64_t Increment = 1442695040888963407ull; //(any odd number; this one is PCG's default stream)
+
+	explicit GameRandom(uint64_t seed = 0) {
+		next();
+		state += seed;
+		next();
+	}
+
+	uint32_t next() {
+		uint64_t old = state;
+		state = old * 6364136223846793005ull + Increment;
+		uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+		uint32_t rot = uint32_t(old >> 59u);
+		return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+	}
+
+	//uniform in [lo, hi) (24 random bits, so the float math is exact until the final scale):
+	float uniform(float lo, float hi) {
+		float t = float(next() >> 8) * (1.0f / 16777216.0f);
+		return lo + (hi - lo) * t;
+	}
+
+	//uniform in [0, n):
+	uint32_t below(uint32_t n) {
+		return uint32_t((uint64_t(next()) * n) >> 32);
+	}
+};
+
 struct Game {
 	std::list< Player > players; //(using list so they can have stable addresses)
 	Player *spawn_player(); //add player the end of the players list (may also, e.g., play some spawn anim)
@@ -80,13 +293,74 @@ struct Game {
 
 	uint32_t next_player_number = 1; //used for naming players
 
+	//random seed (a fresh match every time):
 	Game();
+	//deterministic mode: the same seed and the same controls each tick give bit-identical states
+	// (on any machine whose floats are IEEE single precision, built with floating-point contraction off -- see Maekfile.js):
+	explicit Game(uint64_t seed);
+
+	//every random choice the simulation makes comes from here:
+	uint64_t seed = 0;
+	GameRandom random;
+
+	//checksum (64-bit FNV-1a) of the complete simulation state -- everything update() reads or writes, but no networking bookkeeping:
+	// (equal hashes on two machines after the same ticks mean the simulations haven't diverged)
+	uint64_t hash() const;
+
+	//the same complete simulation state in fixed-size storage, so saving and restoring a tick never allocates (see Rollback):
+	struct Frame {
+		inline static constexpr uint32_t MaxPlayers = 4;
+		struct PlayerState {
+			Button up, down;
+			float position = 0.0f;
+			float velocity = 0.0f;
+			uint32_t score = 0;
+			PowerUpSet power_ups;
+		};
+		uint8_t player_count = 0;
+		std::array< PlayerState, MaxPlayers > players;
+
+		glm::vec2 ball_position = glm::vec2(0.0f);
+		glm::vec2 ball_direction = glm::vec2(0.0f);
+		glm::vec2 prev_ball_position = glm::vec2(0.0f);
+		float ball_speed = 0.0f;
+		PowerUp power_up;
+		float power_up_cooldown = 0.0f;
+		EffectTimers effect_timers;
+		uint64_t random_state = 0;
+		uint8_t sounds_to_play = 0;
+	};
+	//throws if there are more players than a Frame holds:
+	void save(Frame *frame) const;
+	//the game must already have frame.player_count players (restoring only overwrites them):
+	void restore(Frame const &frame);
 
 	//state update function:
 	void update(float elapsed);
 
+	//ball movement for one update: sweeps the ball along its path, bouncing off (or scoring on) whatever it touches first, as many times as needed:
+	// (the prevBallPosition left behind is where the ball started the update)
+	void move_ball(float elapsed);
+	inline static constexpr uint32_t MaxBallSteps = 16; //(contacts handled per update -- any time left after that is dropped)
+	//the ball went over the power-up pad:
+	void collect_power_up();
+	//'player' (number 'index') gets one of 'type' if it can hold another, starting its timer in *timers if it's the first of a timed type:
+	// (static, so other modes with players and EffectTimers -- see Arena -- follow the same rules; 'tick' is the seconds each timer tick stands for)
+	static void gain_power_up(Player &player, uint8_t index, PowerUp::Type type, EffectTimers *timers, float tick);
+	//the timer for 'player' (number 'index') holding 'type' ran out:
+	static void expire_power_up(Player &player, uint8_t index, PowerUp::Type type, EffectTimers *timers, float tick);
+
+	//paddle movement for one (unfrozen) player, following its controls -- used by update() and by client-side prediction:
+	static void move_player(Player &player, float elapsed);
+	//0.5^(elapsed / halflife), using only basic arithmetic (which IEEE floats round the same everywhere, unlike std::pow):
+	static float halflife_decay(float elapsed, float halflife);
+
+	//seconds per update() on the server -- the server picks its simulation rate at startup, and tells clients with send_rates_message:
+	// (power-up timers count ticks of this length, so it matters to the simulation, not just to the clocks)
+	float tick = Tick;
+
 	//constants:
-	//the update rate on the server:
+	//the default update rate on the server:
 	inline static constexpr float Tick = 1.0f / 30.0f;
 
 	//arena size:
@@ -118,9 +392,23 @@ struct Game {
 	inline static constexpr glm::vec2 PowerUpPadSize = glm::vec2(10.0f, 10.0f);
 	inline static constexpr float BallSpeedUpFactor = 1.5f;
 
+	//what each power-up does (indexed by PowerUp::Type):
+	inline static constexpr std::array< PowerUpEffect, PowerUp::TYPE_LENGTH > PowerUpEffects{{
+		//ExtraLife:
+		{.target = PowerUpEffect::Sender, .max_stack = 16, .saves_goal = true},
+		//Freeze:
+		{.target = PowerUpEffect::Receiver, .duration = Player::FreezeTimer, .max_stack = 16, .freezes = true},
+		//SpeedUp:
+		{.target = PowerUpEffect::Ball, .ball_speed_factor = BallSpeedUpFactor},
+	}};
+	//(as PowerUpSet masks)
+	inline static constexpr uint32_t FreezingPowerUps = PowerUpEffect::mask_where(PowerUpEffects, &PowerUpEffect::freezes);
+	inline static constexpr uint32_t GoalSavingPowerUps = PowerUpEffect::mask_where(PowerUpEffects, &PowerUpEffect::saves_goal);
+
 	//power ups:
 	PowerUp currPowerUp;
 	float currPowerUpCooldown = PowerUpCooldown;
+	EffectTimers effect_timers; //(when held power-ups run out)
 
 	//sound trigger:
 	uint8_t sounds_to_play = 0;
@@ -136,12 +424,150 @@ struct Game {
 	//---- communication helpers ----
 
 	//used by client:
-	//set game state from data in connection buffer
-	// (return true if data was read)
-	bool recv_state_message(Connection *connection);
+	//set game state from a state message in 'buffer' (see MessageDispatch) -- returns 'false' if it was skipped instead:
+	//  If a newer complete state message is already waiting further on in 'buffer' (even behind other messages), 'message' is
+	//  dropped without decoding (counted in skipped_states) and its sounds added to sounds_to_play, which collects sounds until
+	//  the client clears it. So of the states that piled up, only the newest is decoded.
+	//throws on malformed state message
+	bool recv_state_message(RingBuffer const &buffer, MessageView const &message);
+	uint64_t skipped_states = 0;
+
+	//encoding to ask the server for:
+	StateEncoding state_encoding = StateEncoding::Raw;
+
+	//let the server know the newest snapshot received (state_seq) and the encoding to send from now on:
+	// (the server sends deltas against the acknowledged snapshot; also send once after connecting to pick an encoding)
+	void send_state_ack_message(Connection *connection) const;
+
+	//snapshots per second to ask the server for (0: one every tick), sent with send_state_ack_message:
+	// (the server rounds it to a whole number of ticks between snapshots -- lower rates for clients with less bandwidth)
+	uint8_t state_send_rate = 0;
+
+	//the server's rates, as of the newest rates message (tick is above):
+	uint32_t state_send_interval = 1; //ticks between snapshots to this client
+
+	//set 'tick' and 'state_send_interval' from a rates message,
+	//throws on malformed rates message
+	void recv_rates_message(MessageView const &message);
+
+	//index in 'players' of the player this client controls (set by recv_state_message):
+	inline static constexpr uint8_t NoPlayer = 0xff;
+	uint8_t local_player = NoPlayer;
+
+	//newest controls seq the server had applied to the local player when it sent this state (set by recv_state_message):
+	uint32_t acked_input_seq = 0;
 
 	//used by server:
-	//send game state.
-	//  Will move "connection_player" to the front of the front of the sent list.
-	void send_state_message(Connection *connection, Player *connection_player = nullptr);
+	//number the current state as a new snapshot (once per tick, after update()):
+	// (the snapshot takes over sounds_to_play, which is reset, since those sounds will now be sent)
+	void take_snapshot();
+
+	//serialize the snapshot from take_snapshot() (must be called before the next update()):
+	// (each encoding is only serialized once per snapshot, and shared between all connections)
+	SharedBytes encode_state(StateEncoding encoding = StateEncoding::Raw);
+
+	//encode the newest snapshot as a delta against an earlier one (in the same encoding):
+	// (returns nullptr if 'baseline' is no longer in state_history -- send the full snapshot instead)
+	SharedBytes encode_state_delta(uint32_t baseline, StateEncoding encoding = StateEncoding::Raw);
+
+	//send game state previously serialized by encode_state() (or, if 'baseline' is nonzero, by encode_state_delta(baseline)).
+	//  The payload itself is shared; only a small per-connection header (which includes the index of "connection_player") is copied.
+	//  'skipped_sounds' are sounds from snapshots this connection didn't get (see sounds_since), sent in the header along with this one's.
+	void send_state_message(Connection *connection, SharedBytes const &state, Player const *connection_player = nullptr, uint32_t baseline = 0, StateEncoding encoding = StateEncoding::Raw, uint8_t skipped_sounds = 0) const;
+	//(the per-connection header that goes in front of a 'payload_size'-byte payload)
+	inline static constexpr uint32_t StateHeaderSize = 19;
+	void write_state_header(uint8_t (&header)[StateHeaderSize], size_t payload_size, Player const *connection_player, uint32_t baseline, StateEncoding encoding, uint8_t skipped_sounds = 0) const;
+
+	//sounds of the snapshots after 'seq', up to but not including the newest (as far back as state_history goes):
+	// (for a connection last sent snapshot 'seq' that is sent one less often than every tick)
+	uint8_t sounds_since(uint32_t seq) const;
+
+	//what a client last reported with send_state_ack_message (the server keeps one per connection):
+	struct StateAck {
+		uint32_t seq = 0; //newest snapshot the client has (0 if none)
+		StateEncoding encoding = StateEncoding::Raw; //encoding the client wants (and that snapshot 'seq' was in)
+		uint8_t send_rate = 0; //snapshots per second the client wants (0: every tick)
+	};
+
+	//set *ack from a state ack message,
+	//throws on malformed state ack message
+	static void recv_state_ack_message(MessageView const &message, StateAck *ack);
+
+	//ticks between snapshots for a client asking for 'send_rate' per second (at least 1):
+	uint32_t send_interval(uint8_t send_rate) const;
+
+	//tell a client the tick length and how many ticks apart its snapshots will be:
+	// (send on connect, before any state, and again if its interval changes)
+	void send_rates_message(Connection *connection, uint32_t send_interval) const;
+
+	//send current game state (take_snapshot() + encode_state() + send_state_message() for a single connection):
+	void send_state_message(Connection *connection, Player const *connection_player = nullptr);
+
+	//index of 'player' in the players list (or NoPlayer):
+	uint8_t player_index(Player const *player) const;
+
+	//---- snapshot history (for delta compression) ----
+
+	//snapshots are numbered from 1 (0 means "none"):
+	// on the server this is the newest snapshot taken, on the client the newest one received.
+	uint32_t state_seq = 0;
+
+	//recent snapshot payloads, in slot seq % StateHistory:
+	inline static constexpr uint32_t StateHistory = 32;
+	inline static constexpr uint32_t StateEncodings = 2;
+	struct StateSlot {
+		uint32_t seq = 0;
+		uint8_t sounds = 0; //(server: snapshot_sounds when it was taken)
+		//indexed by StateEncoding (server: each encoding in use; client: the one received):
+		std::array< SharedBytes, StateEncodings > payloads;
+	};
+	std::array< StateSlot, StateHistory > state_history;
+
+	//payload of snapshot 'seq' in 'encoding' (or nullptr if it isn't in the history):
+	SharedBytes find_state(uint32_t seq, StateEncoding encoding) const;
+
+	//delta format: [varint payload size][one change bit per 4-byte word of the payload][each changed word]
+	// (baseline bytes past its end count as zero; the result replaces the contents of *delta / *state, reusing its capacity)
+	static void delta_encode(std::vector< uint8_t > const &baseline, std::vector< uint8_t > const &state, std::vector< uint8_t > *delta);
+	static void delta_apply(std::vector< uint8_t > const &baseline, std::vector< uint8_t > const &delta, std::vector< uint8_t > *state); //throws on malformed delta
+
+	//set game state from a full snapshot payload (throws on malformed payload):
+	void decode_state(std::vector< uint8_t > const &state, StateEncoding encoding);
+	//(add or drop players at the end to match a snapshot, reusing list nodes from spare_players -- players kept are updated in place)
+	void set_player_count(uint32_t count);
+
+	//packed encoding: positions are rounded to multiples of PositionStep within [ArenaMin, ArenaMax]:
+	inline static constexpr float PositionStep = 1.0f / 64.0f;
+	inline static constexpr uint32_t StepsX = uint32_t((ArenaMax.x - ArenaMin.x) / PositionStep + 0.5f);
+	inline static constexpr uint32_t StepsY = uint32_t((ArenaMax.y - ArenaMin.y) / PositionStep + 0.5f);
+	inline static constexpr uint32_t BitsX = std::bit_width(StepsX);
+	inline static constexpr uint32_t BitsY = std::bit_width(StepsY);
+	//(value in [min, max] to a step in [0, steps], clamped -- and back, throwing if 'q' is past 'steps')
+	static uint32_t quantize(float value, float min, float max, uint32_t steps);
+	static float dequantize(uint32_t q, float min, float max, uint32_t steps);
+
+	//(per-encoding serializers used by encode_state() / decode_state() -- encoding appends to *state):
+	void encode_state_raw(std::vector< uint8_t > *state) const;
+	void encode_state_packed(std::vector< uint8_t > *state) const;
+	void decode_state_raw(std::vector< uint8_t > const &state);
+	void decode_state_packed(std::vector< uint8_t > const &state);
+
+	//sounds triggered since the previous snapshot (taken from sounds_to_play by take_snapshot()):
+	uint8_t snapshot_sounds = 0;
+
+	//---- allocation-free snapshots ----
+	//Once warmed up, neither a server tick (update + take_snapshot + encode_state + encode_state_delta)
+	// nor receiving a snapshot (recv_state_message) allocates:
+
+	//snapshot payloads and deltas are written into pooled buffers, each reused once nothing else holds it
+	// (the pool grows until it covers state_history plus whatever connections still have queued):
+	std::vector< std::shared_ptr< std::vector< uint8_t > > > payload_pool;
+	size_t payload_pool_next = 0; //(where to start looking for a free buffer)
+	std::shared_ptr< std::vector< uint8_t > > take_payload_buffer(); //(empty, keeping its old capacity)
+	inline static constexpr size_t PayloadReserve = 512; //(bytes; a two-player snapshot is well under this, even with every power-up held)
+
+	//decoding a snapshot with fewer players parks the extra list nodes here, to be reused when players come back:
+	std::list< Player > spare_players;
+	//(received delta bytes, before they are applied)
+	std::vector< uint8_t > recv_delta;
 };
@@ -0,0 +1,54 @@
+//GameBatch's kernel with 8-wide AVX2 lanes.
+// This is the only file built with AVX2 enabled (see Maekfile.js); GameBatch only calls into it after checking the CPU has AVX2.
+
+#include "GameBatchKernel.hpp"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace {
+
+struct Lanes8 {
+	inline static constexpr uint32_t Width = 8;
+	__m256 v;
+	static Lanes8 load(float const *p) { return Lanes8{_mm256_loadu_ps(p)}; }
+	void store(float *p) const { _mm256_storeu_ps(p, v); }
+	static Lanes8 set1(float x) { return Lanes8{_mm256_set1_ps(x)}; }
+	Lanes8 operator+(Lanes8 b) const { return Lanes8{_mm256_add_ps(v, b.v)}; }
+	Lanes8 operator-(Lanes8 b) const { return Lanes8{_mm256_sub_ps(v, b.v)}; }
+	Lanes8 operator*(Lanes8 b) const { return Lanes8{_mm256_mul_ps(v, b.v)}; }
+	static Lanes8 min(Lanes8 a, Lanes8 b) { return Lanes8{_mm256_min_ps(a.v, b.v)}; }
+	static Lanes8 max(Lanes8 a, Lanes8 b) { return Lanes8{_mm256_max_ps(a.v, b.v)}; }
+	static __m256 lt(Lanes8 a, Lanes8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+	static __m256 gt(Lanes8 a, Lanes8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+	static __m256 eq(Lanes8 a, Lanes8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ); }
+	static __m256 mask_and(__m256 a, __m256 b) { return _mm256_and_ps(a, b); }
+	static __m256 mask_or(__m256 a, __m256 b) { return _mm256_or_ps(a, b); }
+	static Lanes8 select(__m256 m, Lanes8 a, Lanes8 b) { return Lanes8{_mm256_blendv_ps(b.v, a.v, m)}; }
+	static uint32_t bits(__m256 m) { return uint32_t(_mm256_movemask_ps(m)); }
+};
+
+}
+
+bool game_batch_avx2_built() {
+	return true;
+}
+
+void game_batch_step_avx2(GameBatch::Step const &step, uint32_t begin, uint32_t end) {
+	step_lanes< Lanes8 >(step, begin, end);
+}
+
+#else //(not built for x86-64: GameBatch sticks to its other kernels)
+
+#include <stdexcept>
+
+bool game_batch_avx2_built() {
+	return false;
+}
+
+void game_batch_step_avx2(GameBatch::Step const &, uint32_t, uint32_t) {
+	throw std::runtime_error("GameBatch wasn't built with its AVX2 kernel.");
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include "GameBatch.hpp"
+#include "GameBatchKernel.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GAME_BATCH_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace {
+
+//one match at a time (the kernel, minus the vectors):
+struct Lanes1 {
+	inline static constexpr uint32_t Width = 1;
+	float v;
+	static Lanes1 load(float const *p) { return Lanes1{*p}; }
+	void store(float *p) const { *p = v; }
+	static Lanes1 set1(float x) { return Lanes1{x}; }
+	Lanes1 operator+(Lanes1 b) const { return Lanes1{v + b.v}; }
+	Lanes1 operator-(Lanes1 b) const { return Lanes1{v - b.v}; }
+	Lanes1 operator*(Lanes1 b) const { return Lanes1{v * b.v}; }
+	static Lanes1 min(Lanes1 a, Lanes1 b) { return Lanes1{std::min(a.v, b.v)}; }
+	static Lanes1 max(Lanes1 a, Lanes1 b) { return Lanes1{std::max(a.v, b.v)}; }
+	static bool lt(Lanes1 a, Lanes1 b) { return a.v < b.v; }
+	static bool gt(Lanes1 a, Lanes1 b) { return a.v > b.v; }
+	static bool eq(Lanes1 a, Lanes1 b) { return a.v == b.v; }
+	static bool mask_and(bool a, bool b) { return a && b; }
+	static bool mask_or(bool a, bool b) { return a || b; }
+	static Lanes1 select(bool m, Lanes1 a, Lanes1 b) { return m ? a : b; }
+	static uint32_t bits(bool m) { return m ? 1 : 0; }
+};
+
+#ifdef GAME_BATCH_SSE2
+//four matches at a time:
+struct Lanes4 {
+	inline static constexpr uint32_t Width = 4;
+	__m128 v;
+	static Lanes4 load(float const *p) { return Lanes4{_mm_loadu_ps(p)}; }
+	void store(float *p) const { _mm_storeu_ps(p, v); }
+	static Lanes4 set1(float x) { return Lanes4{_mm_set1_ps(x)}; }
+	Lanes4 operator+(Lanes4 b) const { return Lanes4{_mm_add_ps(v, b.v)}; }
+	Lanes4 operator-(Lanes4 b) const { return Lanes4{_mm_sub_ps(v, b.v)}; }
+	Lanes4 operator*(Lanes4 b) const { return Lanes4{_mm_mul_ps(v, b.v)}; }
+	static Lanes4 min(Lanes4 a, Lanes4 b) { return Lanes4{_mm_min_ps(a.v, b.v)}; }
+	static Lanes4 max(Lanes4 a, Lanes4 b) { return Lanes4{_mm_max_ps(a.v, b.v)}; }
+	static __m128 lt(Lanes4 a, Lanes4 b) { return _mm_cmplt_ps(a.v, b.v); }
+	static __m128 gt(Lanes4 a, Lanes4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+	static __m128 eq(Lanes4 a, Lanes4 b) { return _mm_cmpeq_ps(a.v, b.v); }
+	static __m128 mask_and(__m128 a, __m128 b) { return _mm_and_ps(a, b); }
+	static __m128 mask_or(__m128 a, __m128 b) { return _mm_or_ps(a, b); }
+	static Lanes4 select(__m128 m, Lanes4 a, Lanes4 b) { return Lanes4{_mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v))}; }
+	static uint32_t bits(__m128 m) { return uint32_t(_mm_movemask_ps(m)); }
+};
+#endif
+
+//does the CPU (and OS) do AVX2?
+bool cpu_has_avx2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 6) != 6) return false; //(OS saves the ymm registers)
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+}
+
+GameBatch::GameBatch(uint32_t count_, uint64_t seed) : count(count_) {
+	stride = (count + Lanes - 1) / Lanes * Lanes;
+	arrays.assign(size_t(Fields) * stride, 0.0f);
+	fallback.assign(stride, 0);
+	//(padding matches: a pad that's always up, so their timers never run out)
+	for (uint32_t i = count; i < stride; ++i) {
+		at(PadActive, i) = 1.0f;
+	}
+
+	games.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		games.emplace_back(seed + i);
+		games.back().spawn_player();
+		games.back().spawn_player();
+		gather(i);
+	}
+
+	use_avx2 = cpu_has_avx2() && game_batch_avx2_built();
+}
+
+char const *GameBatch::kernel() const {
+	if (use_avx2) return "avx2";
+#ifdef GAME_BATCH_SSE2
+	return "sse2";
+#else
+	return "portable";
+#endif
+}
+
+void GameBatch::set_controls(uint32_t match, uint32_t player, bool up, bool down) {
+	assert(match < count && player < 2);
+	Player &p = (player == 0 ? games[match].players.front() : games[match].players.back());
+	p.controls.up.pressed = up;
+	p.controls.down.pressed = down;
+
+	//(as Game::move_player)
+	float dir = 0.0f;
+	if (down) dir -= 1.0f;
+	if (up) dir += 1.0f;
+	at(Field(Input0 + player), match) = dir;
+}
+
+Game &GameBatch::scatter(uint32_t match) {
+	assert(match < count);
+	Game &game = games[match];
+	game.BallPosition = glm::vec2(at(BallX, match), at(BallY, match));
+	game.prevBallPosition = glm::vec2(at(PrevX, match), at(PrevY, match));
+	game.BallDirection = glm::vec2(at(DirX, match), at(DirY, match));
+	game.currBallSpeed = at(Speed, match);
+	game.currPowerUpCooldown = at(Cooldown, match);
+	//(the pad only changes in Game::update(), so the game's copy is always current)
+	if (game.players.size() == 2) {
+		game.players.front().position = at(Position0, match);
+		game.players.front().velocity = at(Velocity0, match);
+		game.players.back().position = at(Position1, match);
+		game.players.back().velocity = at(Velocity1, match);
+	}
+	return game;
+}
+
+void GameBatch::gather(uint32_t match) {
+	assert(match < count);
+	Game &game = games[match];
+	at(BallX, match) = game.BallPosition.x;
+	at(BallY, match) = game.BallPosition.y;
+	at(PrevX, match) = game.prevBallPosition.x;
+	at(PrevY, match) = game.prevBallPosition.y;
+	at(DirX, match) = game.BallDirection.x;
+	at(DirY, match) = game.BallDirection.y;
+	at(Speed, match) = game.currBallSpeed;
+	at(Cooldown, match) = game.currPowerUpCooldown;
+	at(PadActive, match) = (game.currPowerUp.active ? 1.0f : 0.0f);
+	at(PadX, match) = game.currPowerUp.Position.x;
+	at(PadY, match) = game.currPowerUp.Position.y;
+
+	bool slow = (game.players.size() != 2);
+	if (!slow) {
+		uint32_t index = 0;
+		for (auto &p : game.players) {
+			if (p.frozen()) slow = true;
+			at(Field(Position0 + index), match) = p.position;
+			at(Field(Velocity0 + index), match) = p.velocity;
+			float dir = 0.0f;
+			if (p.controls.down.pressed) dir -= 1.0f;
+			if (p.controls.up.pressed) dir += 1.0f;
+			at(Field(Input0 + index), match) = dir;
+			index += 1;
+		}
+	}
+	//(held power-ups run out in Game::update(), so while any are counting down every tick goes there)
+	if (!game.effect_timers.empty()) slow = true;
+	at(Slow, match) = (slow ? 1.0f : 0.0f);
+}
+
+void GameBatch::update(float elapsed) {
+	//the per-tick factors, computed exactly as Game::move_player computes them:
+	Step step;
+	step.elapsed = elapsed;
+	float drift_amt = 1.0f - Game::halflife_decay(elapsed, Game::PlayerAccelHalflife * 2.0f);
+	step.drift_keep = 1.0f - drift_amt;
+	float accel_amt = 1.0f - Game::halflife_decay(elapsed, Game::PlayerAccelHalflife);
+	step.accel_keep = 1.0f - accel_amt;
+	step.accel_gain = accel_amt;
+	step.arrays = arrays.data();
+	step.stride = stride;
+	step.fallback = fallback.data();
+
+	if (use_avx2) {
+		game_batch_step_avx2(step, 0, stride);
+	} else {
+#ifdef GAME_BATCH_SSE2
+		step_lanes< Lanes4 >(step, 0, stride);
+#else
+		step_lanes< Lanes1 >(step, 0, stride);
+#endif
+	}
+
+	//matches where something happened get the whole tick from Game::update():
+	for (uint32_t i = 0; i < count; ++i) {
+		if (fallback[i]) {
+			scatter(i).update(elapsed);
+			gather(i);
+			lanes_fallback += 1;
+		} else {
+			lanes_stepped += 1;
+		}
+	}
+}
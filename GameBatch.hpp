@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Game.hpp"
+
+#include <vector>
+
+//Many two-player matches stepped together, for hosting lots of matches per core:
+// the state update() touches every tick (ball, paddles, power-up timer) is kept as structure-of-arrays,
+// and a vectorized kernel (AVX2 when the CPU has it, else SSE2, else plain C++) steps every match at once.
+// Ticks where something happens in a match -- the ball reaching a wall, paddle or pad, a power-up spawning, a frozen paddle --
+// are handed to that match's own Game::update() instead, so the results are bit-for-bit what Game::update() alone would give.
+//
+//The rest of each match (scores, power-ups held, random state, buttons, ...) stays in 'games'.
+// scatter() brings a match's Game up to date (e.g., before encode_state), and gather() reloads it after changing the Game directly.
+struct GameBatch {
+	//'count' matches with two players each (match i is seeded with seed + i):
+	GameBatch(uint32_t count, uint64_t seed);
+
+	uint32_t size() const { return count; }
+
+	//step every match by 'elapsed' seconds:
+	void update(float elapsed);
+
+	//set the buttons held by 'player' (0 or 1) in match 'match':
+	void set_controls(uint32_t match, uint32_t player, bool up, bool down);
+
+	//copy match 'match' from the arrays into games[match] (and return it):
+	Game &scatter(uint32_t match);
+	//copy games[match] into the arrays (after changing it directly):
+	void gather(uint32_t match);
+
+	std::vector< Game > games;
+
+	//which kernel update() uses ("avx2", "sse2", or "portable"):
+	char const *kernel() const;
+
+	//stats:
+	uint64_t lanes_stepped = 0; //match-ticks done by the vector kernel
+	uint64_t lanes_fallback = 0; //match-ticks handed to Game::update()
+
+	//structure-of-arrays state: one row of floats per field, one column per match (rows padded to a multiple of Lanes):
+	inline static constexpr uint32_t Lanes = 8; //(widest kernel)
+	enum Field : uint32_t {
+		BallX, BallY, PrevX, PrevY, DirX, DirY, Speed,
+		Position0, Position1, Velocity0, Velocity1,
+		Input0, Input1, //(down: -1, up: +1, both or neither: 0 -- as in Game::move_player)
+		Cooldown, //power-up spawn timer
+		PadActive, PadX, PadY, //power-up pad (active: 0 or 1)
+		Slow, //1 if every tick of this match needs Game::update() (a paddle is frozen, or a held power-up is counting down)
+		Fields
+	};
+	uint32_t count = 0;
+	uint32_t stride = 0; //(count rounded up to a multiple of Lanes)
+	std::vector< float > arrays;
+	float &at(Field field, uint32_t match) { return arrays[field * stride + match]; }
+
+	//what the kernel gets each tick (plain pointers, so kernels built for other instruction sets don't instantiate any shared inline code):
+	struct Step {
+		float elapsed;
+		float drift_keep; //velocity kept per tick with no buttons held
+		float accel_keep, accel_gain; //blend toward PlayerSpeed per tick with a button held
+		float *arrays;
+		uint32_t stride;
+		uint8_t *fallback; //(set by the kernel: match needs Game::update() this tick)
+	};
+	std::vector< uint8_t > fallback;
+	bool use_avx2 = false; //(picked by the constructor)
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+//GameBatch's kernel, written once over a "bunch of floats" type V and compiled for each instruction set
+// (GameBatch.cpp: plain C++ and SSE2, GameBatch-avx2.cpp: AVX2).
+//
+//V provides: Width, load/store/set1, + - *, min/max, lt/gt/eq (giving a mask), mask_and/mask_or, select(mask, if_true, if_false), and bits(mask).
+//
+//Only plain IEEE arithmetic in the same order as Game::move_player / Game::move_ball is used on the state,
+// so matches stepped here come out bit-identical to Game::update().
+
+#include "GameBatch.hpp"
+
+#include <cstdint>
+
+template< typename V >
+static inline void step_lanes(GameBatch::Step const &step, uint32_t begin, uint32_t end) {
+	auto row = [&](GameBatch::Field field, uint32_t i) { return step.arrays + field * step.stride + i; };
+
+	V const elapsed = V::set1(step.elapsed);
+	V const drift_keep = V::set1(step.drift_keep);
+	V const accel_keep = V::set1(step.accel_keep);
+	V const accel_gain = V::set1(step.accel_gain);
+	V const zero = V::set1(0.0f);
+	V const player_speed = V::set1(Game::PlayerSpeed);
+	V const player_height = V::set1(Game::PlayerHeight);
+	V const paddle_min = V::set1(Game::ArenaMin.y);
+	V const paddle_max = V::set1(Game::ArenaMax.y);
+	V const paddle_low = V::set1(Game::ArenaMin.y + Game::PlayerHeight);
+	V const paddle_high = V::set1(Game::ArenaMax.y - Game::PlayerHeight);
+
+	//anything the ball might touch this tick sends the match to Game::update()
+	// (tested with the ball's bounding box over the whole tick, grown a little so rounding can't sneak a contact past):
+	V const reach = V::set1(Game::BallRadius + 0.01f);
+	V const wall_bottom = V::set1(Game::ArenaMin.y + Game::WallThickness);
+	V const wall_top = V::set1(Game::ArenaMax.y - Game::WallThickness);
+	V const wall_left = V::set1(Game::ArenaMin.x + Game::WallThickness);
+	V const wall_right = V::set1(Game::ArenaMax.x - Game::WallThickness);
+	V const paddle_x_min[2] = {V::set1(-Game::PlayerXPos - Game::PlayerWidth), V::set1(Game::PlayerXPos - Game::PlayerWidth)};
+	V const paddle_x_max[2] = {V::set1(-Game::PlayerXPos + Game::PlayerWidth), V::set1(Game::PlayerXPos + Game::PlayerWidth)};
+	V const pad_half_x = V::set1(Game::PowerUpPadSize.x);
+	V const pad_half_y = V::set1(Game::PowerUpPadSize.y);
+
+	for (uint32_t i = begin; i < end; i += V::Width) {
+		auto slow = V::gt(V::load(row(GameBatch::Slow, i)), zero);
+
+		//paddles (as Game::move_player):
+		V position[2], velocity[2];
+		for (uint32_t p = 0; p < 2; ++p) {
+			V dir = V::load(row(GameBatch::Field(GameBatch::Input0 + p), i));
+			V v = V::load(row(GameBatch::Field(GameBatch::Velocity0 + p), i));
+
+			V drifting = v * drift_keep;
+
+			V along = dir * v;
+			V blended = along * accel_keep + player_speed * accel_gain;
+			along = V::select(V::lt(along, player_speed), blended, along);
+
+			v = V::select(V::eq(dir, zero), drifting, dir * along);
+
+			V x = V::load(row(GameBatch::Field(GameBatch::Position0 + p), i)) + v * elapsed;
+			x = V::select(V::lt(x - player_height, paddle_min), paddle_low, x);
+			x = V::select(V::gt(x + player_height, paddle_max), paddle_high, x);
+
+			position[p] = x;
+			velocity[p] = v;
+		}
+
+		//power-up timer (a spawn needs the match's random numbers):
+		V pad_active = V::load(row(GameBatch::PadActive, i));
+		auto active = V::gt(pad_active, zero);
+		V cooldown = V::load(row(GameBatch::Cooldown, i));
+		cooldown = V::select(active, cooldown, cooldown - elapsed);
+		auto fallback = V::mask_or(slow, V::lt(cooldown, zero));
+
+		//ball, assuming it touches nothing (as Game::move_ball):
+		V bx = V::load(row(GameBatch::BallX, i));
+		V by = V::load(row(GameBatch::BallY, i));
+		V vx = V::load(row(GameBatch::DirX, i)) * V::load(row(GameBatch::Speed, i));
+		V vy = V::load(row(GameBatch::DirY, i)) * V::load(row(GameBatch::Speed, i));
+		V nx = bx + vx * elapsed;
+		V ny = by + vy * elapsed;
+
+		V lo_x = V::min(bx, nx) - reach;
+		V hi_x = V::max(bx, nx) + reach;
+		V lo_y = V::min(by, ny) - reach;
+		V hi_y = V::max(by, ny) + reach;
+
+		fallback = V::mask_or(fallback, V::lt(lo_y, wall_bottom));
+		fallback = V::mask_or(fallback, V::gt(hi_y, wall_top));
+		fallback = V::mask_or(fallback, V::lt(lo_x, wall_left));
+		fallback = V::mask_or(fallback, V::gt(hi_x, wall_right));
+
+		auto overlaps = [&](V box_lo_x, V box_hi_x, V box_lo_y, V box_hi_y) {
+			return V::mask_and(V::mask_and(V::gt(hi_x, box_lo_x), V::lt(lo_x, box_hi_x)), V::mask_and(V::gt(hi_y, box_lo_y), V::lt(lo_y, box_hi_y)));
+		};
+		for (uint32_t p = 0; p < 2; ++p) {
+			fallback = V::mask_or(fallback, overlaps(paddle_x_min[p], paddle_x_max[p], position[p] - player_height, position[p] + player_height));
+		}
+		V pad_x = V::load(row(GameBatch::PadX, i));
+		V pad_y = V::load(row(GameBatch::PadY, i));
+		fallback = V::mask_or(fallback, V::mask_and(active, overlaps(pad_x - pad_half_x, pad_x + pad_half_x, pad_y - pad_half_y, pad_y + pad_half_y)));
+
+		//keep the results for matches where nothing happened (the rest are left as they were for Game::update()):
+		V::select(fallback, bx, nx).store(row(GameBatch::BallX, i));
+		V::select(fallback, by, ny).store(row(GameBatch::BallY, i));
+		V::select(fallback, V::load(row(GameBatch::PrevX, i)), bx).store(row(GameBatch::PrevX, i));
+		V::select(fallback, V::load(row(GameBatch::PrevY, i)), by).store(row(GameBatch::PrevY, i));
+		V::select(fallback, V::load(row(GameBatch::Cooldown, i)), cooldown).store(row(GameBatch::Cooldown, i));
+		for (uint32_t p = 0; p < 2; ++p) {
+			float *pos = row(GameBatch::Field(GameBatch::Position0 + p), i);
+			float *vel = row(GameBatch::Field(GameBatch::Velocity0 + p), i);
+			V::select(fallback, V::load(pos), position[p]).store(pos);
+			V::select(fallback, V::load(vel), velocity[p]).store(vel);
+		}
+
+		uint32_t bits = V::bits(fallback);
+		for (uint32_t j = 0; j < V::Width; ++j) {
+			step.fallback[i + j] = uint8_t((bits >> j) & 1);
+		}
+	}
+}
+
+//(GameBatch-avx2.cpp) step_lanes() with 8-wide AVX2 lanes -- only there when built for x86-64:
+bool game_batch_avx2_built();
+void game_batch_step_avx2(GameBatch::Step const &step, uint32_t begin, uint32_t end);
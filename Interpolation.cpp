@@ -0,0 +1,107 @@
+#include "Interpolation.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+void SnapshotBuffer::push(Game const &game, std::chrono::steady_clock::time_point arrival) {
+	//(snapshots that show up late and out of order are no use for interpolation)
+	if (count > 0 && game.state_seq <= entry(count - 1).seq) return;
+
+	if (double(game.tick) != tick) count = 0; //(stamped at another rate -- see 'tick')
+	tick = double(game.tick);
+
+	if (epoch == std::chrono::steady_clock::time_point()) epoch = arrival;
+
+	if (count == Capacity) {
+		head = (head + 1) % Capacity;
+		count -= 1;
+	}
+	Entry &e = entries[(head + count) % Capacity];
+	count += 1;
+
+	e.seq = game.state_seq;
+	e.time = double(game.state_seq) * tick;
+	e.ball = game.BallPosition;
+	e.paddles.clear();
+	for (auto const &player : game.players) {
+		e.paddles.emplace_back(player.position);
+	}
+
+	double local = std::chrono::duration< double >(arrival - epoch).count();
+	double sample = local - e.time;
+	if (count == 1 || sample < offset) offset = sample;
+	else offset += (sample - offset) * OffsetCreep;
+}
+
+bool SnapshotBuffer::sample(std::chrono::steady_clock::time_point now, View *view) {
+	assert(view);
+	if (count == 0) return false;
+
+	double local = std::chrono::duration< double >(now - epoch).count();
+	double elapsed = std::max(0.0, local - last_sample);
+	last_sample = local;
+
+	double render = local - offset - double(delay);
+
+	Entry const &newest = entry(count - 1);
+	if (render > newest.time) {
+		//ran out of snapshots:
+		if (!starving) starvation_events += 1;
+		starving = true;
+		starved_time += float(elapsed);
+
+		double ahead = std::min(render - newest.time, double(max_extrapolation));
+		if (render - newest.time <= double(max_extrapolation)) extrapolated_time += float(elapsed);
+
+		view->ball = newest.ball;
+		view->paddles = newest.paddles;
+		if (count >= 2 && ahead > 0.0) {
+			//keep moving at the speed between the last two snapshots:
+			Entry const &prev = entry(count - 2);
+			float t = float(ahead / (newest.time - prev.time));
+			if (glm::length(newest.ball - prev.ball) < BallTeleport) {
+				view->ball = newest.ball + (newest.ball - prev.ball) * t;
+			}
+			if (prev.paddles.size() == newest.paddles.size()) {
+				for (size_t p = 0; p < newest.paddles.size(); ++p) {
+					view->paddles[p] = newest.paddles[p] + (newest.paddles[p] - prev.paddles[p]) * t;
+				}
+			}
+		}
+		return true;
+	}
+	starving = false;
+
+	//find the pair of snapshots around 'render' (or clamp to the oldest):
+	uint32_t after = 0;
+	while (after < count && entry(after).time < render) ++after;
+	if (after == 0) {
+		view->ball = entry(0).ball;
+		view->paddles = entry(0).paddles;
+		return true;
+	}
+	Entry const &a = entry(after - 1);
+	Entry const &b = entry(after);
+	float t = float((render - a.time) / (b.time - a.time));
+
+	if (glm::length(b.ball - a.ball) < BallTeleport) {
+		view->ball = glm::mix(a.ball, b.ball, t);
+	} else {
+		view->ball = (t < 0.5f ? a.ball : b.ball);
+	}
+	view->paddles = b.paddles;
+	if (a.paddles.size() == b.paddles.size()) {
+		for (size_t p = 0; p < b.paddles.size(); ++p) {
+			view->paddles[p] = glm::mix(a.paddles[p], b.paddles[p], t);
+		}
+	}
+	return true;
+}
+
+uint32_t SnapshotBuffer::server_tick(std::chrono::steady_clock::time_point now) const {
+	if (count == 0) return 0;
+	double local = std::chrono::duration< double >(now - epoch).count();
+	double server = local - offset;
+	return uint32_t(std::max(1.0, std::floor(server / tick)));
+}
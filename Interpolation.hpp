@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Game.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <chrono>
+
+//Client-side snapshot interpolation for everything the client doesn't predict (ball and remote paddles):
+// snapshots are kept in a small ring, stamped with the server time they were taken at (seq * Game::tick),
+// and rendering samples them 'delay' seconds in the past so there is usually a snapshot on either side to interpolate between.
+// If the newest snapshot is older than that (the buffer "starved"), motion is extrapolated for up to 'max_extrapolation' seconds and then holds.
+struct SnapshotBuffer {
+	//record the state just received into 'game' (call after recv_state_message):
+	void push(Game const &game, std::chrono::steady_clock::time_point arrival);
+
+	//interpolated state at local time 'now' (minus 'delay'):
+	struct View {
+		glm::vec2 ball = glm::vec2(0.0f);
+		std::vector< float > paddles; //position of each player, in 'players' order
+	};
+	//returns false if there is nothing to show yet:
+	bool sample(std::chrono::steady_clock::time_point now, View *view);
+
+	//estimate of the tick the server is on at local time 'now' (0 if no snapshots yet):
+	// (used to stamp inputs so the server can apply them on the tick they were meant for)
+	uint32_t server_tick(std::chrono::steady_clock::time_point now) const;
+
+	//tuning (seconds):
+	float delay = 2.0f * Game::Tick; //how far behind the newest snapshot to render
+	float max_extrapolation = Game::Tick; //how far past the newest snapshot to keep things moving
+
+	//stats:
+	uint32_t starvation_events = 0; //times rendering caught up with the newest snapshot
+	float starved_time = 0.0f; //total seconds spent past the newest snapshot
+	float extrapolated_time = 0.0f; //(the part of starved_time that was extrapolated rather than held)
+
+	//internals:
+	struct Entry {
+		uint32_t seq = 0;
+		double time = 0.0; //server time the snapshot was taken (seconds)
+		glm::vec2 ball = glm::vec2(0.0f);
+		std::vector< float > paddles;
+	};
+	inline static constexpr uint32_t Capacity = 32;
+	std::array< Entry, Capacity > entries; //oldest at 'head'
+	double tick = 0.0; //(Game::tick the entries were stamped with -- if the server's rates arrive after its first snapshots, those are dropped)
+	uint32_t head = 0;
+	uint32_t count = 0;
+	Entry const &entry(uint32_t i) const { return entries[(head + i) % Capacity]; }
+
+	//local arrival time minus server time, tracking the fastest recent arrivals:
+	// (drops immediately on an early arrival, creeps up slowly if the network gets slower)
+	double offset = 0.0;
+	inline static constexpr double OffsetCreep = 0.01;
+	std::chrono::steady_clock::time_point epoch; //(local times are seconds since the first push)
+
+	bool starving = false;
+	double last_sample = 0.0; //(local time of the previous sample() call, for the starvation stats)
+
+	//ball moves further than this between snapshots only when it is reset, so don't interpolate across that:
+	inline static constexpr float BallTeleport = 0.25f * (Game::ArenaMax.x - Game::ArenaMin.x);
+};
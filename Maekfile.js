@@ -26,6 +26,7 @@ const NEST_LIBS = `../nest-libs/${maek.OS}`;
 if (maek.OS === "windows") {
 	maek.options.CPPFlags.push(
 		`/O2`, //optimize
+		`/fp:precise`, //keep float math as written, no contraction into fma (Game's deterministic mode relies on it)
 		`/D_USE_MATH_DEFINES`, //make sure M_PI exists
 		//include paths for nest libraries:
 		`/I${NEST_LIBS}/SDL3/include`,
@@ -57,6 +58,7 @@ if (maek.OS === "windows") {
 } else if (maek.OS === "linux") {
 	maek.options.CPPFlags.push(
 		`-O2`, //optimize
+		`-ffp-contract=off`, //no contracting a*b+c into fma (Game's deterministic mode relies on every float operation being rounded)
 		//include paths for nest libraries:
 		`-I${NEST_LIBS}/SDL3/include`, `-D_THREAD_SAFE`,
 		`-I${NEST_LIBS}/glm/include`,
@@ -81,6 +83,7 @@ if (maek.OS === "windows") {
 } else if (maek.OS === "macos") {
 	maek.options.CPPFlags.push(
 		`-O2`, //optimize
+		`-ffp-contract=off`, //(as on linux)
 		//include paths for nest libraries:
 		`-I${NEST_LIBS}/SDL3/include`, `-D_THREAD_SAFE`,
 		`-I${NEST_LIBS}/glm/include`,
@@ -159,12 +162,42 @@ const client_names = [
 	maek.CPP('load_opus.cpp')
 ];
 
+//a server worker's rooms (also driven directly by sim-bench):
+const room_names = [
+	maek.CPP('Room.cpp'),
+	maek.CPP('TickScheduler.cpp')
+];
+
 const server_names = [
-	maek.CPP('server.cpp')
+	maek.CPP('server.cpp'),
+	...room_names
 ];
 
-const common_names = [
+//just the simulation (Game's message helpers need Connection, but nothing else):
+const sim_names = [
 	maek.CPP('Game.cpp'),
+	maek.CPP('Message.cpp'),
+	maek.CPP('Connection.cpp')
+];
+
+//game state + networking (no SDL / GL), also used by the headless tools:
+const game_names = [
+	...sim_names,
+	maek.CPP('Prediction.cpp'),
+	maek.CPP('Interpolation.cpp'),
+	maek.CPP('ClockSync.cpp'),
+	maek.CPP('Rollback.cpp'),
+	maek.CPP('GameBatch.cpp'),
+	maek.CPP('Arena.cpp'),
+	//(the only file built for AVX2 -- GameBatch checks the CPU before calling it; elsewhere it builds as a stub)
+	maek.CPP('GameBatch-avx2.cpp', undefined, { CPPFlags: [
+		...maek.options.CPPFlags,
+		...(process.arch !== 'x64' ? [] : maek.OS === 'windows' ? [`/arch:AVX2`] : [`-mavx2`])
+	] })
+];
+
+const common_names = [
+	...game_names,
 	maek.CPP('data_path.cpp'),
 	maek.CPP('PathFont.cpp'),
 	maek.CPP('PathFont-font.cpp'),
@@ -177,11 +210,35 @@ const common_names = [
 	maek.CPP('Mode.cpp'),
 	maek.CPP('GL.cpp'),
 	maek.CPP('Load.cpp'),
-	maek.CPP('Connection.cpp'),
 	maek.CPP('hex_dump.cpp'),
 	maek.CPP('TextManager.cpp')
 ];
 
+const loadgen_names = [
+	maek.CPP('loadgen.cpp')
+];
+
+const bandwidth_names = [
+	maek.CPP('bandwidth.cpp')
+];
+
+const rollback_bench_names = [
+	maek.CPP('rollback-bench.cpp')
+];
+
+const batch_bench_names = [
+	maek.CPP('batch-bench.cpp')
+];
+
+const arena_bench_names = [
+	maek.CPP('arena-bench.cpp')
+];
+
+const sim_bench_names = [
+	maek.CPP('sim-bench.cpp'),
+	maek.CPP('AllocationCounter.cpp') //(counts every allocation, to check the tick and snapshot paths don't make any)
+];
+
 const show_meshes_names = [
 	maek.CPP('show-meshes.cpp'),
 	maek.CPP('ShowMeshesProgram.cpp'),
@@ -203,8 +260,17 @@ const server_exe = maek.LINK([...server_names, ...common_names], 'dist/server');
 const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
 
+//headless tools only need the system libraries (no SDL / GL / nest-libs):
+const headless_libs = (maek.OS === 'windows' ? [] : [`-lpthread`, `-lm`]);
+const loadgen_exe = maek.LINK([...loadgen_names, ...game_names], 'dist/loadgen', { LINKLibs: headless_libs });
+const bandwidth_exe = maek.LINK([...bandwidth_names, ...game_names], 'dist/bandwidth', { LINKLibs: headless_libs });
+const rollback_bench_exe = maek.LINK([...rollback_bench_names, ...game_names], 'dist/rollback-bench', { LINKLibs: headless_libs });
+const batch_bench_exe = maek.LINK([...batch_bench_names, ...game_names], 'dist/batch-bench', { LINKLibs: headless_libs });
+const arena_bench_exe = maek.LINK([...arena_bench_names, ...game_names], 'dist/arena-bench', { LINKLibs: headless_libs });
+const sim_bench_exe = maek.LINK([...sim_bench_names, ...room_names, ...game_names], 'dist/sim-bench', { LINKLibs: headless_libs });
+
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [client_exe, server_exe, show_meshes_exe, show_scene_exe, ...copies];
+maek.TARGETS = [client_exe, server_exe, loadgen_exe, bandwidth_exe, rollback_bench_exe, batch_bench_exe, arena_bench_exe, sim_bench_exe, show_meshes_exe, show_scene_exe, ...copies];
 
 //Note that tasks that produce ':abstract targets' are never cached.
 // This is similar to how .PHONY targets behave in make.
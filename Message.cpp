@@ -0,0 +1,77 @@
+#include "Message.hpp"
+
+#include "Connection.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+std::string message_name(uint8_t type) {
+	MessageInfo const &info = MessageRegistry[type];
+	if (info.name) return info.name;
+	return "unknown (type " + std::to_string(type) + ")";
+}
+
+bool MessageView::parse(RingBuffer const &buffer, size_t offset) {
+	//expecting [type, size_low0, size_mid8, size_high8]:
+	if (buffer.size() < offset + MessageHeaderSize) return false;
+	uint8_t type_byte = buffer[offset];
+	MessageInfo const &info = MessageRegistry[type_byte];
+	if (!info.name) throw std::runtime_error("Message of unknown type " + std::to_string(type_byte) + ".");
+	uint32_t payload_size = (uint32_t(buffer[offset + 3]) << 16) | (uint32_t(buffer[offset + 2]) << 8) | uint32_t(buffer[offset + 1]);
+	if (payload_size < info.min_size || payload_size > info.max_size) {
+		throw std::runtime_error(std::string(info.name) + " message with size " + std::to_string(payload_size) + " is out of range ["
+			+ std::to_string(info.min_size) + ", " + std::to_string(info.max_size) + "]!");
+	}
+
+	//expecting complete message:
+	if (buffer.size() < offset + MessageHeaderSize + payload_size) return false;
+
+	type = Message(type_byte);
+	size = payload_size;
+	std::span< uint8_t const > run = buffer.read_span(offset + MessageHeaderSize);
+	first = run.first(std::min< size_t >(size, run.size()));
+	second = (first.size() < size ? buffer.read_span(offset + MessageHeaderSize + first.size()).first(size - first.size()) : std::span< uint8_t const >());
+	end = offset + MessageHeaderSize + size;
+	return true;
+}
+
+bool peek_message(RingBuffer const &buffer, Message type, MessageView *message) {
+	assert(message);
+	if (buffer.empty() || buffer[0] != uint8_t(type)) return false;
+	return message->parse(buffer);
+}
+
+void MessageDispatch::on(Message type, Handler handler) {
+	assert(message_info(type).name && "handlers are for types in MessageRegistry");
+	handlers[uint8_t(type)] = std::move(handler);
+}
+
+void MessageDispatch::on(Message type, std::function< void(MessageView const &message) > handler) {
+	on(type, Handler([handler = std::move(handler)](RingBuffer const &, MessageView const &message) {
+		handler(message);
+	}));
+}
+
+uint32_t MessageDispatch::dispatch(RingBuffer &buffer) const {
+	uint32_t handled = 0;
+	MessageView message;
+	while (message.parse(buffer)) {
+		Handler const &handler = handlers[uint8_t(message.type)];
+		if (!handler) throw std::runtime_error("Unexpected " + message_name(uint8_t(message.type)) + " message.");
+		handler(buffer, message);
+		buffer.consume(message.end);
+		handled += 1;
+	}
+	return handled;
+}
+
+uint32_t MessageDispatch::dispatch(Connection *connection) const {
+	assert(connection);
+	uint32_t handled = dispatch(connection->recv_buffer) + dispatch(connection->unreliable_recv_buffer);
+	//(an unreliable message arrives whole, in one datagram -- so anything left of it is malformed, and would otherwise sit in the slot)
+	if (!connection->unreliable_recv_buffer.empty()) {
+		connection->unreliable_recv_buffer.clear();
+		throw std::runtime_error("Truncated unreliable message.");
+	}
+	return handled;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <span>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+struct Connection;
+struct RingBuffer;
+
+//Framing shared by every message on the wire:
+//  [type (1 byte), payload size (24 bits, little-endian), payload]
+// - MessageRegistry says what each type's payload may look like (so sizes are checked in one place, as soon as a header is in)
+// - BufferWriter builds messages in place: begin() reserves the header, finish() patches in the size
+// - MessageView is one complete received message, with its payload as spans into the receive buffer (nothing is copied)
+// - MessageDispatch hands each complete message to the handler for its type (one table lookup, not a probe per type)
+
+enum class Message : uint8_t {
+	C2S_Controls = 1, //Greg!
+	C2S_StateAck = 'a',
+	S2C_State = 's',
+	C2S_Ping = 'p', //(see ClockSync)
+	S2C_Pong = 'P',
+	S2C_Rates = 'R', //(server's tick and this connection's snapshot interval -- see Game::send_rates_message)
+	Peer_RollbackInput = 'r', //(between rollback peers, directly or relayed by the server -- see Rollback)
+	//... (add new types to MessageRegistry too)
+};
+
+inline constexpr uint32_t MessageHeaderSize = 4;
+inline constexpr uint32_t MaxMessageSize = 0xffffff; //(largest payload a 24-bit size can describe)
+
+//what a message type's payload may look like (payload sizes in bytes, header not included):
+struct MessageInfo {
+	char const *name = nullptr; //(nullptr: not a message type)
+	uint32_t min_size = 0;
+	uint32_t max_size = 0;
+};
+
+//indexed by type byte (the layouts themselves are documented where each message is sent):
+inline constexpr std::array< MessageInfo, 256 > MessageRegistry = []() {
+	std::array< MessageInfo, 256 > registry{};
+	auto add = [&](Message type, char const *name, uint32_t min_size, uint32_t max_size) {
+		registry[uint8_t(type)] = MessageInfo{name, min_size, max_size};
+	};
+	add(Message::C2S_Controls, "controls", 4 + 4 + 1 + 3, 4 + 4 + 1 + 3 * 255); //(Player::Controls::send_controls_message)
+	add(Message::C2S_StateAck, "state ack", 4 + 1 + 1, 4 + 1 + 1); //(Game::send_state_ack_message)
+	add(Message::S2C_State, "state", 1 + 1 + 4 + 4 + 4 + 1, MaxMessageSize); //(Game::write_state_header, then the payload)
+	add(Message::C2S_Ping, "ping", 8 + 4, 8 + 4); //(ClockSync)
+	add(Message::S2C_Pong, "pong", 8 + 8, 8 + 8);
+	add(Message::S2C_Rates, "rates", 4 + 2, 4 + 2); //(Game::send_rates_message)
+	add(Message::Peer_RollbackInput, "rollback input", 1 + 4 + 4 + 1, 1 + 4 + 4 + 1 + 255); //(Rollback)
+	return registry;
+}();
+
+constexpr MessageInfo const &message_info(Message type) {
+	return MessageRegistry[uint8_t(type)];
+}
+
+//(for error messages -- the registry name, or the type byte if it isn't one)
+std::string message_name(uint8_t type);
+
+//Builds messages into caller-provided storage (typically a buffer on the stack, then handed to Connection::send_unreliable or send_raw):
+struct BufferWriter {
+	explicit BufferWriter(std::span< uint8_t > storage_) : storage(storage_) { }
+
+	//start a message, leaving room for the header:
+	void begin(Message type) {
+		assert(start == NoMessage && "finish() the last message before starting another");
+		start = at;
+		check_room(MessageHeaderSize);
+		storage[at] = uint8_t(type);
+		at += MessageHeaderSize;
+	}
+
+	template< typename T >
+	void write(T const &t) {
+		write_raw(&t, sizeof(T));
+	}
+	void write_raw(void const *data, size_t size) {
+		check_room(size);
+		std::memcpy(&storage[at], data, size);
+		at += size;
+	}
+
+	//patch the size of the message begun last into its header:
+	// ('trailing' payload bytes follow separately -- e.g., a shared snapshot sent after its per-connection header)
+	void finish(size_t trailing = 0) {
+		assert(start != NoMessage && "begin() a message before finishing it");
+		uint32_t size = uint32_t(at - start - MessageHeaderSize + trailing);
+		[[maybe_unused]] MessageInfo const &info = message_info(Message(storage[start]));
+		assert(info.name && size >= info.min_size && size <= info.max_size && "message size out of the registry's bounds");
+		storage[start + 1] = uint8_t(size);
+		storage[start + 2] = uint8_t(size >> 8);
+		storage[start + 3] = uint8_t(size >> 16);
+		start = NoMessage;
+	}
+
+	//everything written so far (all finished messages):
+	uint8_t const *data() const { return storage.data(); }
+	size_t size() const { return at; }
+
+	void check_room([[maybe_unused]] size_t size) const {
+		assert(at + size <= storage.size() && "message doesn't fit its BufferWriter's storage");
+	}
+
+	inline static constexpr size_t NoMessage = size_t(-1);
+	std::span< uint8_t > storage;
+	size_t at = 0; //bytes written
+	size_t start = NoMessage; //where the unfinished message begins
+};
+
+//One complete message in a receive buffer:
+// (the spans point into the buffer's storage, so they stay valid until the buffer is next appended to)
+struct MessageView {
+	Message type = Message(0);
+	uint32_t size = 0; //payload bytes
+	std::span< uint8_t const > first, second; //the payload -- 'second' is the part that wrapped around the ring buffer (usually empty)
+	size_t end = 0; //offset just past this message in its buffer (where the next one starts)
+
+	//view the message starting 'offset' bytes into 'buffer' -- false if it hasn't all arrived yet;
+	// throws if the type isn't in MessageRegistry or the size is out of bounds for it (checked as soon as the header is in):
+	bool parse(RingBuffer const &buffer, size_t offset = 0);
+
+	uint8_t operator[](size_t i) const {
+		assert(i < size);
+		return (i < first.size() ? first[i] : second[i - first.size()]);
+	}
+
+	//copy 'count' payload bytes starting at 'offset' into 'data':
+	void copy_out(size_t offset, void *data, size_t count) const {
+		assert(offset + count <= size);
+		uint8_t *dst = reinterpret_cast< uint8_t * >(data);
+		if (offset < first.size()) {
+			size_t take = std::min(count, first.size() - offset);
+			std::memcpy(dst, first.data() + offset, take);
+			dst += take;
+			count -= take;
+			offset = 0;
+		} else {
+			offset -= first.size();
+		}
+		if (count) std::memcpy(dst, second.data() + offset, count);
+	}
+
+	template< typename T >
+	T read(size_t offset) const {
+		T t;
+		copy_out(offset, &t, sizeof(T));
+		return t;
+	}
+};
+
+//if the front of 'buffer' is a complete message of type 'type', view it (for code that takes one type at a time -- remember to consume it):
+bool peek_message(RingBuffer const &buffer, Message type, MessageView *message);
+
+//Handlers for each message type, indexed by type byte:
+struct MessageDispatch {
+	//a handler gets one complete message, and the buffer it is in -- to look ahead at what else has arrived
+	// (see Game::recv_state_message, which skips stale snapshots); the message is consumed once the handler returns:
+	using Handler = std::function< void(RingBuffer const &buffer, MessageView const &message) >;
+	void on(Message type, Handler handler);
+	//(for the usual handler, which only needs its own message)
+	void on(Message type, std::function< void(MessageView const &message) > handler);
+
+	//handle every complete message at the front of 'buffer', consuming them; returns how many were handled:
+	// (throws on messages of a type without a handler, so a peer sending the wrong thing gets noticed)
+	uint32_t dispatch(RingBuffer &buffer) const;
+	//(both of a connection's buffers: the stream, then the newest unreliable message -- which is always consumed, see Connection::unreliable_recv_buffer)
+	uint32_t dispatch(Connection *connection) const;
+
+	std::array< Handler, 256 > handlers;
+};
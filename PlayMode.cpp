@@ -110,6 +110,27 @@ PlayMode::PlayMode(Client &client_) : scene(*pong_scene), client(client_)
 	samples.emplace_back(*power_up_sample);
 
 	music_loop = Sound::loop(*music_sample, 0.3f);
+
+	// handle messages from the server:
+	dispatch.on(Message::S2C_State, [this](RingBuffer const &buffer, MessageView const &message)
+				{
+		// (only states actually decoded -- a stale one skipped behind a newer one doesn't count)
+		if (game.recv_state_message(buffer, message))
+			snapshots.push(game, std::chrono::steady_clock::now()); });
+	dispatch.on(Message::S2C_Pong, [this](MessageView const &message)
+				{ clock.recv_pong_message(message, std::chrono::steady_clock::now()); });
+	dispatch.on(Message::S2C_Rates, [this](MessageView const &message)
+				{
+		game.recv_rates_message(message);
+		// render two snapshot intervals behind, whatever rate the server picked (unless the player chose a delay):
+		float interval = game.tick * float(game.state_send_interval);
+		snapshots.delay = (fixed_delay >= 0.0f ? fixed_delay : 2.0f * interval);
+		// (either way, keep things moving through one missing snapshot)
+		snapshots.max_extrapolation = interval; });
+
+	// ask the server for the compact state encoding:
+	game.state_encoding = StateEncoding::Packed;
+	game.send_state_ack_message(&client.connection);
 }
 
 PlayMode::~PlayMode()
@@ -158,13 +179,23 @@ bool PlayMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size)
 void PlayMode::update(float elapsed)
 {
 
-	// queue data for sending to server:
+	// number, stamp with the server tick it is meant for, and queue data for sending to server:
+	controls.seq += 1;
+	// (before the first pong, the snapshot arrival times give a rougher estimate)
+	auto now = std::chrono::steady_clock::now();
+	controls.tick = (clock.synced ? clock.server_tick(now, game.tick) : snapshots.server_tick(now));
 	controls.send_controls_message(&client.connection);
 
+	// move the local paddle right away (the server will catch up):
+	prediction.apply(controls, elapsed);
+
 	// reset button press counters:
 	controls.up.downs = 0;
 	controls.down.downs = 0;
 
+	// keep the clock estimate fresh:
+	clock.update(&client.connection, now);
+
 	// send/receive data:
 	client.poll([this](Connection *c, Connection::Event event)
 				{
@@ -174,13 +205,16 @@ void PlayMode::update(float elapsed)
 			std::cout << "[" << c->socket << "] closed (!)" << std::endl;
 			throw std::runtime_error("Lost connection to server!");
 		} else { assert(event == Connection::OnRecv);
-			//std::cout << "[" << c->socket << "] recv'd data. Current buffer:\n" << hex_dump(c->recv_buffer); std::cout.flush(); //DEBUG
-			bool handled_message;
+			//std::cout << "[" << c->socket << "] recv'd data. Current buffer:\n" << hex_dump(c->recv_buffer.linearize().data(), c->recv_buffer.size()); std::cout.flush(); //DEBUG
+			uint32_t state_seq = game.state_seq;
 			try {
-				do {
-					handled_message = false;
-					if (game.recv_state_message(c)) handled_message = true;
-				} while (handled_message);
+				dispatch.dispatch(c);
+				if (game.state_seq != state_seq) {
+					//acknowledge the newest snapshot so the server can send deltas against it:
+					game.send_state_ack_message(c);
+					//replay the inputs the server hadn't applied yet on top of it:
+					prediction.reconcile(game);
+				}
 			} catch (std::exception const &e) {
 				std::cerr << "[" << c->socket << "] malformed message from server: " << e.what() << std::endl;
 				//quit the game:
@@ -188,12 +222,38 @@ void PlayMode::update(float elapsed)
 			}
 		} }, 0.0);
 
-	// Place the paddles
-	paddleLeft->position = glm::vec3(-paddlePos, game.players.front().position, paddleLeft->position.z);
-	paddleRight->position = glm::vec3(paddlePos, game.players.back().position, paddleRight->position.z);
+	// Interpolate the rest of the scene from recent snapshots
+	bool interpolated = snapshots.sample(std::chrono::steady_clock::now(), &view) && view.paddles.size() == game.players.size();
+
+	// Place the paddles (the local one where the prediction says it is)
+	float leftPosition = (interpolated ? view.paddles.front() : game.players.front().position);
+	float rightPosition = (interpolated ? view.paddles.back() : game.players.back().position);
+	if (prediction.active)
+	{
+		if (game.local_player == 0)
+			leftPosition = prediction.display_position();
+		else if (game.local_player + 1 == game.players.size())
+			rightPosition = prediction.display_position();
+	}
+	paddleLeft->position = glm::vec3(-paddlePos, leftPosition, paddleLeft->position.z);
+	paddleRight->position = glm::vec3(paddlePos, rightPosition, paddleRight->position.z);
 
 	// Place the ball
-	ball->position = glm::vec3(game.BallPosition, game.BallRadius);
+	ball->position = glm::vec3(interpolated ? view.ball : game.BallPosition, game.BallRadius);
+
+	// Report when rendering outran the snapshots (if this happens a lot, the interpolation delay is too short for this network)
+	starvation_report_timer += elapsed;
+	if (starvation_report_timer > 5.0f)
+	{
+		if (snapshots.starvation_events != reported_starvation_events)
+		{
+			std::cout << "Snapshot buffer starved " << (snapshots.starvation_events - reported_starvation_events) << " times in the last "
+					  << int(starvation_report_timer) << "s (" << int(snapshots.starved_time * 1000.0f) << " ms starved in total, interpolation delay "
+					  << int(snapshots.delay * 1000.0f) << " ms, rtt " << int(clock.rtt * 1000.0f) << " ms, jitter " << int(clock.jitter * 1000.0f) << " ms)." << std::endl;
+			reported_starvation_events = snapshots.starvation_events;
+		}
+		starvation_report_timer = 0.0f;
+	}
 
 	// Place the power up pad
 	{
@@ -221,6 +281,8 @@ void PlayMode::update(float elapsed)
 			oneshots[sound] = Sound::play(samples[sound], 0.3f);
 		}
 	}
+	// (snapshots add to sounds_to_play, so each sound is played once)
+	game.sounds_to_play = 0;
 }
 
 void PlayMode::draw(glm::uvec2 const &drawable_size)
@@ -248,5 +310,11 @@ void PlayMode::draw(glm::uvec2 const &drawable_size)
 	std::string score_str = std::to_string(game.players.front().score) + " - " + std::to_string(game.players.back().score);
 	tm.draw_text(score_str, drawable_size, glm::vec2(drawable_size.x / 2.0f, 36), glm::vec3(0.0f, 0.0f, 0.0f));
 
+	if (clock.synced)
+	{
+		std::string rtt_str = std::to_string(int(clock.rtt * 1000.0f + 0.5f)) + " ms";
+		tm.draw_text(rtt_str, drawable_size, glm::vec2(16.0f, 36), glm::vec3(0.0f, 0.0f, 0.0f));
+	}
+
 	GL_ERRORS();
 }
@@ -2,6 +2,9 @@
 
 #include "Connection.hpp"
 #include "Game.hpp"
+#include "Prediction.hpp"
+#include "Interpolation.hpp"
+#include "ClockSync.hpp"
 #include "Scene.hpp"
 #include "Sound.hpp"
 #include "TextManager.hpp"
@@ -28,6 +31,23 @@ struct PlayMode : Mode {
 	//latest game state (from server):
 	Game game;
 
+	//local paddle, predicted ahead of the server:
+	Prediction prediction;
+
+	//recent snapshots, for smoothly drawing the ball and remote paddles:
+	SnapshotBuffer snapshots;
+	SnapshotBuffer::View view;
+	//interpolation delay the player asked for (seconds; negative: two snapshot intervals, whatever rate the server picks):
+	float fixed_delay = -1.0f;
+	float starvation_report_timer = 0.0f;
+	uint32_t reported_starvation_events = 0;
+
+	//round-trip time and server clock, from pinging the server:
+	ClockSync clock;
+
+	//handlers for messages from the server (set up in the constructor):
+	MessageDispatch dispatch;
+
 	//text display
 	TextManager tm = TextManager();
 
@@ -0,0 +1,67 @@
+#include "Prediction.hpp"
+
+#include <iterator>
+#include <cmath>
+
+void Prediction::apply(Player::Controls const &controls, float elapsed) {
+	//ease out the last correction:
+	correction *= std::pow(0.5f, elapsed / CorrectionHalflife);
+
+	Input input;
+	input.seq = controls.seq;
+	input.up = controls.up.pressed;
+	input.down = controls.down.pressed;
+	input.elapsed = elapsed;
+
+	//(frozen paddles don't move on the server, so don't move them here either)
+	if (active && !player.frozen()) {
+		player.controls.up.pressed = input.up;
+		player.controls.down.pressed = input.down;
+		Game::move_player(player, elapsed);
+	}
+	input.velocity = player.velocity;
+
+	inputs.emplace_back(input);
+	if (inputs.size() > MaxInputs) inputs.pop_front();
+}
+
+void Prediction::reconcile(Game const &game) {
+	if (game.local_player >= game.players.size()) {
+		//not playing (yet):
+		active = false;
+		inputs.clear();
+		correction = 0.0f;
+		return;
+	}
+	Player const &server = *std::next(game.players.begin(), game.local_player);
+
+	//forget inputs the server has already applied:
+	while (!inputs.empty() && inputs.front().seq <= game.acked_input_seq) {
+		acked_velocity = inputs.front().velocity;
+		inputs.pop_front();
+	}
+
+	float before = display_position();
+
+	//start over from the server's state:
+	player.position = server.position;
+	player.velocity = acked_velocity;
+	player.score = server.score;
+	player.powerUps = server.powerUps;
+
+	//replay what the server hasn't seen yet:
+	if (!player.frozen()) {
+		for (auto &input : inputs) {
+			player.controls.up.pressed = input.up;
+			player.controls.down.pressed = input.down;
+			Game::move_player(player, input.elapsed);
+			input.velocity = player.velocity;
+		}
+	}
+
+	//draw from where the paddle was, easing into the corrected prediction:
+	last_error = (active ? before - player.position : 0.0f);
+	correction = (std::abs(last_error) > MaxCorrection ? 0.0f : last_error);
+
+	active = true;
+}
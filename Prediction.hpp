@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Game.hpp"
+
+#include <deque>
+
+//Client-side prediction of the local player's paddle:
+// each frame's controls are applied locally as soon as they are sent (with the same Game::move_player the server uses),
+// and remembered until a snapshot shows the server has applied them too.
+// When a snapshot arrives, the prediction restarts from the server's paddle and replays the inputs the server hasn't seen yet.
+struct Prediction {
+	//apply controls just sent to the server (numbered by 'controls.seq') for 'elapsed' seconds:
+	void apply(Player::Controls const &controls, float elapsed);
+
+	//restart from the local player in a newly received snapshot, then replay the unacknowledged inputs:
+	void reconcile(Game const &game);
+
+	//where to draw the local paddle (the prediction, plus what is left of the last correction):
+	float display_position() const { return player.position + correction; }
+
+	bool active = false; //got a snapshot with a local player to predict from
+
+	//predicted local player:
+	Player player;
+
+	//inputs sent but not yet applied by the server:
+	struct Input {
+		uint32_t seq;
+		bool up, down;
+		float elapsed;
+		float velocity; //player velocity after this input was applied
+	};
+	std::deque< Input > inputs;
+	inline static constexpr size_t MaxInputs = 256; //(oldest are dropped if the server stops acknowledging)
+
+	//velocity after the newest input the server has applied (the server doesn't send velocities):
+	float acked_velocity = 0.0f;
+
+	//reconciliation snaps the prediction to the corrected position, but the paddle is drawn easing in from where it was:
+	float correction = 0.0f;
+	float last_error = 0.0f; //how far off the drawn paddle was at the last reconcile (for stats)
+	inline static constexpr float CorrectionHalflife = 0.05f;
+	inline static constexpr float MaxCorrection = Game::PlayerHeight; //(bigger corrections just snap)
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+
+//Growable FIFO of bytes stored in a power-of-two ring:
+// - append() at the back and consume() from the front are O(1) (no memmove of the remaining data)
+// - read_span() / write_span() expose contiguous regions so send() / recv() can work in-place
+// - operator[] and copy_out() index relative to the front, hiding the wrap-around
+struct RingBuffer {
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t capacity() const { return storage.size(); }
+
+	uint8_t &operator[](size_t i) {
+		assert(i < count);
+		return storage[(head + i) & (storage.size() - 1)];
+	}
+	uint8_t const &operator[](size_t i) const {
+		assert(i < count);
+		return storage[(head + i) & (storage.size() - 1)];
+	}
+
+	//copy 'size' bytes to the back of the buffer (growing if needed):
+	void append(void const *data, size_t size) {
+		if (size == 0) return;
+		reserve(count + size);
+		uint8_t const *src = reinterpret_cast< uint8_t const * >(data);
+		size_t tail = (head + count) & (storage.size() - 1);
+		size_t first = std::min(size, storage.size() - tail);
+		std::memcpy(&storage[tail], src, first);
+		if (first < size) std::memcpy(&storage[0], src + first, size - first);
+		count += size;
+	}
+
+	//drop 'size' bytes from the front of the buffer:
+	void consume(size_t size) {
+		assert(size <= count);
+		count -= size;
+		//when empty, rewind so the next write_span() is as large as possible:
+		if (count == 0) head = 0;
+		else head = (head + size) & (storage.size() - 1);
+	}
+
+	void clear() {
+		head = 0;
+		count = 0;
+	}
+
+	//copy 'size' bytes starting 'offset' bytes from the front into 'data':
+	void copy_out(size_t offset, void *data, size_t size) const {
+		assert(offset + size <= count);
+		if (size == 0) return;
+		uint8_t *dst = reinterpret_cast< uint8_t * >(data);
+		size_t at = (head + offset) & (storage.size() - 1);
+		size_t first = std::min(size, storage.size() - at);
+		std::memcpy(dst, &storage[at], first);
+		if (first < size) std::memcpy(dst + first, &storage[0], size - first);
+	}
+
+	//largest contiguous run of readable bytes starting 'offset' bytes from the front:
+	// (pass to send(), then consume() however many bytes were actually sent)
+	std::span< uint8_t const > read_span(size_t offset = 0) const {
+		assert(offset <= count);
+		if (offset == count) return {};
+		size_t at = (head + offset) & (storage.size() - 1);
+		return std::span< uint8_t const >(&storage[at], std::min(count - offset, storage.size() - at));
+	}
+
+	//contiguous run of free bytes at the back, growing the buffer so at least 'min_free' bytes are free in total:
+	// (pass to recv(), then commit() however many bytes were actually received)
+	// NOTE: the free space may wrap around, so the returned span can be shorter than 'min_free'.
+	std::span< uint8_t > write_span(size_t min_free) {
+		reserve(count + std::max< size_t >(min_free, 1));
+		size_t tail = (head + count) & (storage.size() - 1);
+		size_t free = storage.size() - count;
+		return std::span< uint8_t >(&storage[tail], std::min(free, storage.size() - tail));
+	}
+
+	//mark 'size' bytes at the front of the last write_span() as filled:
+	void commit(size_t size) {
+		assert(count + size <= storage.size());
+		count += size;
+	}
+
+	//rotate the contents so they are contiguous; returns all readable bytes:
+	// (mostly useful for debugging, e.g., hex_dump)
+	std::span< uint8_t const > linearize() {
+		if (count == 0) return {};
+		if (head + count > storage.size()) {
+			std::rotate(storage.begin(), storage.begin() + head, storage.end());
+			head = 0;
+		}
+		return std::span< uint8_t const >(&storage[head], count);
+	}
+
+	//make sure at least 'size' bytes fit without further allocation:
+	void reserve(size_t size) {
+		if (size <= storage.size()) return;
+		size_t new_capacity = std::max< size_t >(storage.size(), MinCapacity);
+		while (new_capacity < size) new_capacity *= 2;
+		std::vector< uint8_t > new_storage(new_capacity);
+		copy_out(0, new_storage.data(), count);
+		storage = std::move(new_storage);
+		head = 0;
+	}
+
+	inline static constexpr size_t MinCapacity = 1024; //(must be a power of two)
+
+	//internals:
+	std::vector< uint8_t > storage; //size is always zero or a power of two
+	size_t head = 0; //index of the first readable byte in storage
+	size_t count = 0; //number of readable bytes
+};
@@ -0,0 +1,147 @@
+#include "Rollback.hpp"
+
+#include "Connection.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+//message: [type, size (24 bits), sender's player index, first tick (u32), newest remote tick received (u32), count, count x [bit 0: up, bit 1: down]]
+// (inputs from 'first tick' on, oldest first; each message repeats every input not yet confirmed, so over datagrams it can go unreliably)
+constexpr uint32_t InputHeaderSize = 1 + 4 + 4 + 1;
+static_assert(message_info(Message::Peer_RollbackInput).min_size == InputHeaderSize, "MessageRegistry should match the layout above.");
+
+Rollback::Rollback(uint64_t seed, uint8_t local_player_) : game(seed), local_player(local_player_), remote_player(1 - local_player_) {
+	if (local_player > 1) throw std::runtime_error("Rollback sessions have players 0 and 1, not " + std::to_string(local_player) + ".");
+	game.spawn_player();
+	game.spawn_player();
+	game.save(&slot(0).frame);
+}
+
+void Rollback::simulate(uint32_t t) {
+	Slot &s = slot(t);
+	//guess that the remote player is still doing whatever they did last:
+	if (t > remote_confirmed) {
+		s.remote = (remote_confirmed ? slot(remote_confirmed).remote : Input());
+	}
+
+	auto player = game.players.begin();
+	for (uint8_t index = 0; index < 2; ++index, ++player) {
+		Input const &input = (index == local_player ? s.local : s.remote);
+		player->controls.up.pressed = input.up;
+		player->controls.down.pressed = input.down;
+	}
+	game.update(Game::Tick);
+	game.save(&s.frame);
+}
+
+bool Rollback::advance(Input local) {
+	if (tick + 1 > remote_confirmed + MaxRollback) {
+		stalls += 1;
+		return false;
+	}
+
+	//correct the past first:
+	settle();
+
+	tick += 1;
+	slot(tick).local = local;
+	simulate(tick);
+	return true;
+}
+
+void Rollback::settle() {
+	if (rollback_from == 0) return;
+	assert(rollback_from + MaxRollback >= tick);
+	uint32_t depth = tick - rollback_from + 1;
+	rollbacks += 1;
+	resimulated_ticks += depth;
+	max_rollback = std::max(max_rollback, depth);
+
+	game.restore(slot(rollback_from - 1).frame);
+	for (uint32_t t = rollback_from; t <= tick; ++t) {
+		simulate(t);
+	}
+	rollback_from = 0;
+}
+
+void Rollback::add_remote_input(uint32_t t, Input input) {
+	if (t <= remote_confirmed) return; //(already have it)
+	if (t != remote_confirmed + 1) throw std::runtime_error("Remote input for tick " + std::to_string(t) + " skips ahead of tick " + std::to_string(remote_confirmed + 1) + ".");
+	//(the peer stalls before getting further ahead than this, so its inputs always fit in the ring)
+	if (t + MaxRollback + 1 >= tick + Frames) throw std::runtime_error("Remote input for tick " + std::to_string(t) + " is too far ahead of tick " + std::to_string(tick) + ".");
+
+	Slot &s = slot(t);
+	if (t <= tick && !(s.remote == input)) {
+		//guessed wrong -- re-simulate from here on the next advance():
+		if (rollback_from == 0 || t < rollback_from) rollback_from = t;
+	}
+	s.remote = input;
+	remote_confirmed = t;
+}
+
+void Rollback::send_input_message(Connection *connection) const {
+	assert(connection);
+
+	//everything the peer hasn't confirmed (but no further back than the ring goes):
+	uint32_t first = std::max(remote_acked + 1, tick > Frames - 1 ? tick - (Frames - 1) : 1u);
+	if (first > tick) first = tick + 1; //(nothing new: still send, to carry the ack)
+	uint32_t count = tick + 1 - first;
+	assert(count < 256);
+
+	static thread_local uint8_t message[MessageHeaderSize + InputHeaderSize + Frames];
+	BufferWriter writer(message);
+	writer.begin(Message::Peer_RollbackInput);
+	writer.write(local_player);
+	writer.write(first);
+	writer.write(remote_confirmed);
+	writer.write(uint8_t(count));
+	for (uint32_t i = 0; i < count; ++i) {
+		Input const &input = slot(first + i).local;
+		writer.write(uint8_t((input.up ? 1 : 0) | (input.down ? 2 : 0)));
+	}
+	writer.finish();
+	connection->send_unreliable(writer.data(), writer.size(), nullptr);
+}
+
+void Rollback::recv_input_message(MessageView const &message) {
+	if (message[0] != remote_player) throw std::runtime_error("Rollback input message from player " + std::to_string(message[0]) + " (expecting player " + std::to_string(remote_player) + ").");
+	uint32_t first = message.read< uint32_t >(1);
+	uint32_t ack = message.read< uint32_t >(5);
+	uint32_t count = message[9];
+	if (message.size != InputHeaderSize + count) throw std::runtime_error("Rollback input message with size " + std::to_string(message.size) + " doesn't match its " + std::to_string(count) + " inputs!");
+	if (first == 0) throw std::runtime_error("Rollback input message starting at tick 0.");
+
+	remote_acked = std::max(remote_acked, std::min(ack, tick));
+
+	//(a message that starts past the next tick needed means an earlier one was lost -- wait for a later one to repeat the gap)
+	if (first <= remote_confirmed + 1) {
+		for (uint32_t i = 0; i < count; ++i) {
+			uint8_t bits = message[InputHeaderSize + i];
+			if (bits & ~3) throw std::runtime_error("Rollback input with unknown buttons.");
+			Input input;
+			input.up = (bits & 1);
+			input.down = (bits & 2);
+			add_remote_input(first + i, input);
+		}
+	}
+}
+
+bool Rollback::recv_input_message(RingBuffer &recv_buffer) {
+	MessageView message;
+	if (!peek_message(recv_buffer, Message::Peer_RollbackInput, &message)) return false;
+	recv_input_message(message);
+	recv_buffer.consume(message.end);
+	return true;
+}
+
+void Rollback::take_input_message(MessageView const &message, uint8_t sender, std::vector< uint8_t > *relayed) {
+	assert(relayed);
+	relayed->resize(MessageHeaderSize + message.size);
+	BufferWriter writer(*relayed);
+	writer.begin(Message::Peer_RollbackInput);
+	writer.write(sender); //(peers can't speak for each other)
+	message.copy_out(1, relayed->data() + writer.size(), message.size - 1);
+	writer.finish(message.size - 1);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Game.hpp"
+
+#include <array>
+#include <vector>
+
+struct Connection;
+struct RingBuffer;
+
+//Rollback (GGPO-style) two-player session built on a deterministic (seeded) Game:
+// each peer simulates every tick right away with its own input, guessing that the other player's buttons haven't changed since their newest known input.
+// When the other player's real input for a tick arrives and differs from the guess, the game is restored to the tick before
+// and re-simulated up to the present. The state after each recent tick is kept in a preallocated ring of Game::Frames, so that costs no allocations.
+// A peer that gets more than MaxRollback ticks ahead of the inputs it has waits for them instead.
+//
+//Peers exchange inputs with Peer_RollbackInput messages, over a direct Connection (one peer runs a Server, the other a Client)
+// or through a server that relays them (see take_input_message). Both peers must start from the same seed.
+struct Rollback {
+	//'local_player' is 0 or 1 (the other player is the remote one):
+	Rollback(uint64_t seed, uint8_t local_player);
+
+	Game game; //state after 'tick'
+	uint32_t tick = 0; //ticks simulated (tick 1 is the first)
+	uint8_t local_player;
+	uint8_t remote_player;
+
+	struct Input {
+		bool up = false;
+		bool down = false;
+		bool operator==(Input const &) const = default;
+	};
+
+	//simulate the next tick with 'local' as the local player's input (first re-simulating if late remote inputs changed the past):
+	// returns false (without simulating) if the remote player's inputs are too far behind -- try again once more arrive.
+	bool advance(Input local);
+
+	//re-simulate now if late remote inputs changed the past (advance() does this too; call it to show 'game' right after receiving inputs):
+	void settle();
+
+	//remote player's input for 'tick' (inputs must arrive in order; repeats are ignored):
+	void add_remote_input(uint32_t tick, Input input);
+
+	//send the local inputs the peer hasn't confirmed yet, along with the newest remote tick received:
+	void send_input_message(Connection *connection) const;
+
+	//take the remote inputs from a rollback input message (see MessageDispatch),
+	//throws on malformed message (or one from the wrong player)
+	void recv_input_message(MessageView const &message);
+	//(the same, for a buffer of nothing but rollback input messages: returns 'false' if there was no complete one at the front)
+	bool recv_input_message(RingBuffer &recv_buffer);
+
+	//(server, relaying) copy a whole rollback input message, stamped with the sender's player index,
+	// to pass on to the other peer as-is:
+	static void take_input_message(MessageView const &message, uint8_t sender, std::vector< uint8_t > *relayed);
+
+	//tuning:
+	inline static constexpr uint32_t MaxRollback = 12; //(ticks -- 400 ms at 30 Hz)
+	inline static constexpr uint32_t Frames = 32; //(ring size: covers MaxRollback ticks back plus the remote inputs that can arrive early)
+	static_assert(Frames >= 2 * MaxRollback + 2, "ring must hold MaxRollback past frames and remote inputs up to MaxRollback ahead");
+
+	//stats:
+	uint32_t rollbacks = 0; //times a late input changed the past
+	uint32_t resimulated_ticks = 0; //ticks simulated again because of those
+	uint32_t max_rollback = 0; //deepest re-simulation (ticks)
+	uint32_t stalls = 0; //advance() calls that had to wait for remote inputs
+
+	//internals:
+	struct Slot {
+		Game::Frame frame; //state after this tick
+		Input local; //local input for this tick
+		Input remote; //remote input (confirmed if tick <= remote_confirmed, else the guess the frame was simulated with)
+	};
+	std::array< Slot, Frames > slots; //(tick t is in slot t % Frames; slot 0 starts out holding the initial state)
+	Slot &slot(uint32_t t) { return slots[t % Frames]; }
+	Slot const &slot(uint32_t t) const { return slots[t % Frames]; }
+
+	uint32_t remote_confirmed = 0; //remote inputs up to this tick have arrived
+	uint32_t remote_acked = 0; //the peer has local inputs up to this tick
+	uint32_t rollback_from = 0; //earliest tick simulated with a wrong guess (0 if none)
+
+	void simulate(uint32_t t); //(simulate tick t from the state after t - 1, which must be current)
+};
@@ -0,0 +1,275 @@
+#include "Room.hpp"
+
+#include "ClockSync.hpp"
+#include "Rollback.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <cassert>
+
+void Room::update() {
+	ticks += 1;
+
+	//apply the inputs clients meant for this tick:
+	for (auto &player : game.players) {
+		player.controls.apply_inputs(game.state_seq + 1);
+	}
+
+	//update current game state
+	game.update(game.tick);
+	game.take_snapshot();
+	last_step = std::chrono::steady_clock::now();
+}
+
+//first snapshot after 'seq' that falls on 'schedule's ticks:
+static uint32_t next_send_seq(uint32_t seq, Room::SendSchedule const &schedule) {
+	uint32_t next = seq + 1;
+	uint32_t phase = schedule.phase % schedule.interval;
+	return next + (phase + schedule.interval - next % schedule.interval) % schedule.interval;
+}
+
+void Room::schedule_sends(Connection *c, uint32_t phase) {
+	SendSchedule &schedule = connection_to_send[c];
+	schedule.phase = phase;
+	schedule.interval = game.send_interval(connection_to_ack.at(c).send_rate);
+	schedule.next_seq = next_send_seq(game.state_seq, schedule);
+	game.send_rates_message(c, schedule.interval);
+}
+
+void Room::update_send_rate(Connection *c) {
+	SendSchedule &schedule = connection_to_send.at(c);
+	uint32_t interval = game.send_interval(connection_to_ack.at(c).send_rate);
+	if (interval == schedule.interval) return;
+	schedule.interval = interval;
+	schedule.next_seq = next_send_seq(game.state_seq, schedule);
+	game.send_rates_message(c, interval);
+}
+
+void Room::send() {
+	//send the newest game state to all clients:
+	// (state is serialized once per encoding in use and shared by every connection's send queue)
+
+	//clients that have acknowledged a recent snapshot get a delta against it instead:
+	// (clients in a room usually share a baseline, so each delta is also only encoded once -- see 'deltas')
+	assert(deltas.empty());
+	for (auto &[c, player] : connection_to_player) {
+		//(only to the connections due a snapshot this tick -- they also get the sounds of the ones they didn't get)
+		SendSchedule &schedule = connection_to_send.at(c);
+		if (game.state_seq < schedule.next_seq) continue;
+		uint8_t skipped_sounds = (schedule.last_seq != 0 ? game.sounds_since(schedule.last_seq) : 0);
+		schedule.last_seq = game.state_seq;
+		schedule.next_seq = next_send_seq(game.state_seq, schedule);
+
+		Game::StateAck const &ack = connection_to_ack.at(c);
+		SharedBytes state = game.encode_state(ack.encoding);
+		SharedBytes delta;
+		if (ack.seq != 0) {
+			auto f = std::find_if(deltas.begin(), deltas.end(), [&](Delta const &d) { return d.baseline == ack.seq && d.encoding == ack.encoding; });
+			if (f != deltas.end()) {
+				delta = f->bytes;
+			} else {
+				delta = game.encode_state_delta(ack.seq, ack.encoding);
+				deltas.emplace_back(Delta{ack.seq, ack.encoding, delta});
+			}
+		}
+		if (delta && delta->size() < state->size()) {
+			game.send_state_message(c, delta, player, ack.seq, ack.encoding, skipped_sounds);
+		} else {
+			game.send_state_message(c, state, player, 0, ack.encoding, skipped_sounds);
+		}
+	}
+	deltas.clear(); //(so the payloads can go back to the pool)
+}
+
+double Room::game_time(std::chrono::steady_clock::time_point now) const {
+	return double(game.state_seq) * double(game.tick) + std::chrono::duration< double >(now - last_step).count();
+}
+
+//-----------------------------------------
+
+RoomWorker::RoomWorker(std::string const &port, uint32_t index_, bool share_port, Transport transport, TickScheduler::CatchUp catch_up, float tick_) : index(index_), tick(tick_),
+	#ifdef __linux__
+	//epoll keeps the per-poll cost proportional to the number of *active* clients:
+	server(port, PollBackend::Epoll, share_port, transport),
+	#else
+	server(port, PollBackend::Select, share_port, transport),
+	#endif
+	scheduler(server, tick, catch_up)
+{
+}
+
+void RoomWorker::add_connection(Connection *c) {
+	Room *room = nullptr;
+	for (auto &r : rooms) {
+		if (!r.full()) {
+			room = &r;
+			break;
+		}
+	}
+	if (!room) {
+		rooms.emplace_back();
+		room = &rooms.back();
+		room->game.tick = tick;
+	}
+
+	//create some player info for them:
+	room->connection_to_player.emplace(c, room->game.spawn_player());
+	room->connection_to_ack.emplace(c, Game::StateAck());
+	room->connection_to_rtt.emplace(c, 0.0f);
+	room->schedule_sends(c, connections_added++);
+	connection_to_room.emplace(c, room);
+}
+
+void RoomWorker::remove_connection(Connection *c) {
+	auto f = connection_to_room.find(c);
+	assert(f != connection_to_room.end());
+	Room *room = f->second;
+	connection_to_room.erase(f);
+
+	closed_dropped_bytes += c->dropped_bytes;
+	if (c->overflowed) slow_disconnects += 1;
+
+	auto p = room->connection_to_player.find(c);
+	assert(p != room->connection_to_player.end());
+	room->game.remove_player(p->second);
+	room->connection_to_player.erase(p);
+	room->connection_to_ack.erase(c);
+	room->connection_to_rtt.erase(c);
+	room->connection_to_send.erase(c);
+
+	if (room->connection_to_player.empty()) {
+		for (auto r = rooms.begin(); r != rooms.end(); ++r) {
+			if (&*r == room) {
+				rooms.erase(r);
+				break;
+			}
+		}
+	}
+}
+
+void RoomWorker::run() {
+	using Clock = std::chrono::steady_clock;
+	auto next_report = Clock::now() + std::chrono::seconds(10);
+
+	std::vector< uint8_t > relay; //(rollback input message being passed on)
+
+	Clock::duration recv_time = Clock::duration::zero(); //(spent handling events since the last tick)
+
+	//handlers for messages from clients -- 'from' is the connection being handled, in 'room', controlling 'player':
+	Connection *from = nullptr;
+	Room *room = nullptr;
+	Player *player = nullptr;
+	MessageDispatch dispatch;
+	dispatch.on(Message::C2S_Controls, [&](MessageView const &message) {
+		player->controls.recv_controls_message(message, room->game.state_seq);
+	});
+	dispatch.on(Message::C2S_StateAck, [&](MessageView const &message) {
+		Game::recv_state_ack_message(message, &room->connection_to_ack.at(from));
+		room->update_send_rate(from);
+	});
+	dispatch.on(Message::C2S_Ping, [&](MessageView const &message) {
+		ClockSync::recv_ping_message(from, message, room->game_time(Clock::now()), &room->connection_to_rtt.at(from));
+	});
+	//rollback peers only need their inputs passed along:
+	dispatch.on(Message::Peer_RollbackInput, [&](MessageView const &message) {
+		Rollback::take_input_message(message, room->game.player_index(player), &relay);
+		for (auto &[other, other_player] : room->connection_to_player) {
+			if (other != from) other->send_unreliable(relay.data(), relay.size(), nullptr);
+		}
+	});
+	//any other type -- one not in MessageRegistry, or one that only the server sends -- makes dispatch() throw,
+	// and the client is disconnected (in OnRecv, below): a client sending those is broken, so there is no use reading on.
+
+	std::function< void(Connection *, Connection::Event) > on_event = [&](Connection *c, Connection::Event evt){
+		auto before = Clock::now();
+		if (evt == Connection::OnOpen) {
+			//client connected:
+			add_connection(c);
+
+		} else if (evt == Connection::OnClose) {
+			//client disconnected:
+			remove_connection(c);
+
+		} else { assert(evt == Connection::OnRecv);
+			//got data from client:
+
+			//look up in players list:
+			from = c;
+			room = connection_to_room.at(c);
+			player = room->connection_to_player.at(c);
+
+			//handle messages from client (disconnecting it if they are malformed or of an unexpected type):
+			try {
+				dispatch.dispatch(c);
+			} catch (std::exception const &e) {
+				std::cout << "Disconnecting client: " << e.what() << std::endl;
+				c->close();
+				remove_connection(c);
+			}
+		}
+		recv_time += Clock::now() - before;
+	};
+
+	scheduler.restart(); //(the schedule starts now, not when the worker was constructed)
+
+	while (true) {
+		//process incoming data from clients until a tick is due:
+		uint32_t due = scheduler.wait(on_event);
+
+		//step every room -- each phase for all rooms at once, so it can be timed as a whole:
+		auto before_update = Clock::now();
+		//(a burst of catch-up ticks only sends the newest state)
+		for (uint32_t t = 0; t < due; ++t) {
+			for (auto &room : rooms) room.update();
+		}
+		auto before_send = Clock::now();
+		for (auto &room : rooms) room.send();
+		auto after_send = Clock::now();
+
+		scheduler.finish_ticks(
+			std::chrono::duration< double >(recv_time).count(),
+			std::chrono::duration< double >(before_send - before_update).count(),
+			std::chrono::duration< double >(after_send - before_send).count()
+		);
+		recv_time = Clock::duration::zero();
+
+		//periodically report load:
+		if (after_send > next_report) {
+			next_report += std::chrono::seconds(10);
+			float rtt_total = 0.0f, rtt_max = 0.0f;
+			uint32_t rtt_count = 0;
+			for (auto const &room : rooms) {
+				for (auto const &[c, rtt] : room.connection_to_rtt) {
+					if (rtt <= 0.0f) continue;
+					rtt_total += rtt;
+					rtt_max = std::max(rtt_max, rtt);
+					rtt_count += 1;
+				}
+			}
+			uint32_t congested = 0;
+			uint64_t dropped_bytes = closed_dropped_bytes;
+			for (auto const &c : server.connections) {
+				if (c.socket == InvalidSocket) continue;
+				if (c.congested) congested += 1;
+				dropped_bytes += c.dropped_bytes;
+			}
+			auto const &stats = scheduler.stats;
+			auto us = [](double seconds) { return int64_t(seconds * 1e6); };
+			std::cout << "[worker " << index << "] " << rooms.size() << " rooms, " << connection_to_room.size() << " clients, "
+				<< stats.ticks << " ticks (" << stats.late << " late, " << stats.dropped << " dropped), "
+				<< "jitter p99 < " << us(stats.jitter.percentile(0.99)) << " us, "
+				<< "work p99 < " << us(stats.recv.percentile(0.99)) << "/" << us(stats.update.percentile(0.99)) << "/" << us(stats.send.percentile(0.99)) << " us recv/update/send";
+			if (rtt_count) std::cout << ", rtt " << int(rtt_total / rtt_count * 1000.0f) << " ms average, " << int(rtt_max * 1000.0f) << " ms max";
+			if (congested || dropped_bytes || slow_disconnects) {
+				std::cout << ", " << congested << " clients not keeping up (" << dropped_bytes / 1024 << " KiB of snapshots dropped so far, " << slow_disconnects << " disconnected)";
+			}
+			std::cout << "." << std::endl;
+			//(the histograms in full, for scripts to pick up)
+			std::cout << "[worker " << index << "] tick-stats ";
+			scheduler.write_stats_json(std::cout);
+			std::cout << std::endl;
+			scheduler.clear_stats();
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Connection.hpp"
+#include "Game.hpp"
+#include "TickScheduler.hpp"
+
+#include <chrono>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//A Room is one match: a Game plus the connections playing in it.
+struct Room {
+	Game game;
+
+	//keep track of which connection is controlling which player:
+	std::unordered_map< Connection *, Player * > connection_to_player;
+
+	//newest snapshot each connection has acknowledged (the baseline for its deltas) and the encoding it wants:
+	std::unordered_map< Connection *, Game::StateAck > connection_to_ack;
+
+	//round-trip time each connection measured with its pings (seconds, 0 until it reports one -- see ClockSync):
+	std::unordered_map< Connection *, float > connection_to_rtt;
+
+	//when each connection gets snapshots: every 'interval' ticks (from the rate in its ack), on the ticks where seq % interval == phase % interval
+	// -- phases are handed out round-robin by the worker, so connections on the same interval take turns instead of all sending on one tick:
+	struct SendSchedule {
+		uint32_t interval = 1;
+		uint32_t phase = 0;
+		uint32_t next_seq = 0; //(first snapshot it is due)
+		uint32_t last_seq = 0; //(newest snapshot it was sent, 0 if none)
+	};
+	std::unordered_map< Connection *, SendSchedule > connection_to_send;
+
+	//start sending to 'c' (number 'phase' of its worker's connections):
+	void schedule_sends(Connection *c, uint32_t phase);
+	//after an ack from 'c': if the rate it asks for changed its interval, reschedule (and tell it):
+	void update_send_rate(Connection *c);
+
+	//pong has two paddles:
+	inline static constexpr uint32_t MaxPlayers = 2;
+	bool full() const { return connection_to_player.size() >= MaxPlayers; }
+
+	//a tick is update() -- advance the game by one Tick and snapshot it -- then send() -- send the newest snapshot to everyone in the room:
+	// (split so the worker can time each phase across all its rooms, and so catch-up ticks can skip sending)
+	void update();
+	void send();
+
+	//deltas send() has encoded this tick, so connections acknowledging the same baseline share one:
+	// (kept between ticks only so the vector's storage is reused -- send() clears it when done)
+	struct Delta {
+		uint32_t baseline;
+		StateEncoding encoding;
+		SharedBytes bytes;
+	};
+	std::vector< Delta > deltas;
+
+	//game clock answered to pings: tick n's snapshot goes out at n * game.tick
+	// (so it runs in step with the ticks, even when they are late)
+	double game_time(std::chrono::steady_clock::time_point now) const;
+	std::chrono::steady_clock::time_point last_step = std::chrono::steady_clock::now(); //(when the newest snapshot was taken)
+
+	//stats:
+	uint64_t ticks = 0; //ticks stepped so far
+};
+
+//A RoomWorker runs the event loop for one thread:
+// it owns a listen socket (sharing the port with the other workers), the connections the OS hands it,
+// and the rooms those connections are placed in.
+struct RoomWorker {
+	RoomWorker(std::string const &port, uint32_t index, bool share_port, Transport transport, TickScheduler::CatchUp catch_up, float tick);
+
+	//accept connections and step rooms every 'tick' seconds, forever:
+	void run();
+
+	uint32_t index; //(used in log messages)
+	float tick; //(every room's Game::tick)
+	Server server;
+	TickScheduler scheduler; //(all rooms on this worker share a tick schedule)
+
+	std::list< Room > rooms; //(using list so they can have stable addresses)
+	std::unordered_map< Connection *, Room * > connection_to_room;
+	uint32_t connections_added = 0; //(round-robin send phases -- see Room::SendSchedule)
+
+	//send queue backpressure (connections keep the default Connection::Backpressure: a client that stops reading
+	// has its unsent snapshots replaced by the newest one), for connections already closed:
+	uint64_t closed_dropped_bytes = 0;
+	uint32_t slow_disconnects = 0; //(closed by Backpressure::Disconnect)
+
+	//put a newly-connected client in a room with a free slot (making a new room if needed):
+	void add_connection(Connection *c);
+	//take a client out of its room (discarding the room if it is now empty):
+	void remove_connection(Connection *c);
+};
@@ -0,0 +1,165 @@
+#include "TickScheduler.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <cmath>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+void TickHistogram::add(double seconds) {
+	double us = std::max(0.0, seconds) * 1e6;
+	uint32_t bucket = 0;
+	if (us >= 1.0) {
+		bucket = std::min(Buckets - 1, uint32_t(std::floor(std::log2(us))) + 1);
+	}
+	counts[bucket] += 1;
+	total += 1;
+	max = std::max(max, seconds);
+}
+
+void TickHistogram::clear() {
+	counts.fill(0);
+	total = 0;
+	max = 0.0;
+}
+
+double TickHistogram::percentile(double p) const {
+	if (total == 0) return 0.0;
+	uint64_t rank = std::max< uint64_t >(1, uint64_t(std::ceil(std::clamp(p, 0.0, 1.0) * double(total))));
+	uint64_t seen = 0;
+	for (uint32_t b = 0; b < Buckets; ++b) {
+		seen += counts[b];
+		if (seen >= rank) {
+			//(the last bucket has no upper edge; the max is the best bound there is)
+			return (b + 1 == Buckets ? max : std::ldexp(1e-6, int(b)));
+		}
+	}
+	return max;
+}
+
+void TickHistogram::write_json(std::ostream &out) const {
+	out << "{\"total\":" << total << ",\"max_us\":" << uint64_t(std::ceil(max * 1e6)) << ",\"buckets_us\":[";
+	bool first = true;
+	for (uint32_t b = 0; b < Buckets; ++b) {
+		if (counts[b] == 0) continue;
+		if (!first) out << ",";
+		first = false;
+		//(upper edge; -1 for the open-ended last bucket)
+		out << "[" << (b + 1 == Buckets ? -1 : int64_t(1) << b) << "," << counts[b] << "]";
+	}
+	out << "]}";
+}
+
+//-----------------------------------------
+
+TickScheduler::TickScheduler(Server &server_, double period_, CatchUp catch_up_) : server(server_),
+	period(std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(period_))),
+	catch_up(catch_up_) {
+	if (period <= Clock::duration::zero()) {
+		throw std::runtime_error("Tick period must be positive.");
+	}
+
+	#ifdef __linux__
+	//(without an epoll instance to wake, the poll timeout is the only way to wait)
+	if (server.epoll_fd >= 0) {
+		timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (timer_fd < 0) {
+			throw std::system_error(errno, std::system_category(), "failed to create timerfd");
+		}
+		server.add_wakeup(timer_fd);
+	}
+	#endif
+	restart();
+}
+
+void TickScheduler::restart() {
+	start = Clock::now();
+	slot = 0;
+
+	#ifdef __linux__
+	if (timer_fd >= 0) {
+		//fire at start + n * period -- steady_clock is CLOCK_MONOTONIC on linux, so these are the same deadlines wait() checks:
+		auto to_timespec = [](Clock::duration d) {
+			auto ns = std::chrono::duration_cast< std::chrono::nanoseconds >(d).count();
+			struct timespec ts;
+			ts.tv_sec = time_t(ns / 1000000000);
+			ts.tv_nsec = long(ns % 1000000000);
+			return ts;
+		};
+		struct itimerspec spec;
+		spec.it_interval = to_timespec(period);
+		spec.it_value = to_timespec((start + period).time_since_epoch());
+		if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+			throw std::system_error(errno, std::system_category(), "failed to arm timerfd");
+		}
+	}
+	#endif
+}
+
+TickScheduler::~TickScheduler() {
+	#ifdef __linux__
+	if (timer_fd >= 0) ::close(timer_fd);
+	#endif
+}
+
+uint32_t TickScheduler::wait(std::function< void(Connection *, Connection::Event event) > const &on_event) {
+	//process incoming data from clients until the next tick is due:
+	Clock::time_point deadline = start + period * int64_t(slot + 1);
+	Clock::time_point now = Clock::now();
+	while (now < deadline) {
+		server.poll(on_event, std::chrono::duration< double >(deadline - now).count());
+		#ifdef __linux__
+		if (timer_fd >= 0) {
+			//(read the expiration count, or the timerfd stays readable and the next poll won't wait; the count itself
+			// isn't needed -- the deadlines passed follow from the clock, which also works without a timer)
+			uint64_t expirations;
+			(void)!::read(timer_fd, &expirations, sizeof(expirations));
+		}
+		#endif
+		now = Clock::now();
+	}
+
+	uint64_t due = uint64_t((now - start) / period); //(deadlines passed, >= slot + 1)
+	uint64_t behind = due - slot;
+	slot = due;
+
+	stats.jitter.add(std::chrono::duration< double >(now - deadline).count());
+	if (behind > 1) stats.late += 1;
+
+	uint32_t run = 1;
+	if (catch_up == CatchUp::Burst) run = uint32_t(std::min< uint64_t >(behind, MaxBurst));
+	stats.dropped += behind - run;
+	stats.ticks += run;
+	return run;
+}
+
+void TickScheduler::finish_ticks(double recv, double update, double send) {
+	stats.recv.add(recv);
+	stats.update.add(update);
+	stats.send.add(send);
+
+	Clock::time_point next = start + period * int64_t(slot + 1);
+	Clock::time_point now = Clock::now();
+	if (now > next) stats.overrun.add(std::chrono::duration< double >(now - next).count());
+}
+
+void TickScheduler::clear_stats() {
+	stats = Stats();
+}
+
+void TickScheduler::write_stats_json(std::ostream &out) const {
+	out << "{\"period_us\":" << std::chrono::duration_cast< std::chrono::microseconds >(period).count()
+		<< ",\"catch_up\":\"" << (catch_up == CatchUp::Skip ? "skip" : "burst") << "\""
+		<< ",\"ticks\":" << stats.ticks << ",\"late\":" << stats.late << ",\"dropped\":" << stats.dropped;
+	out << ",\"jitter\":"; stats.jitter.write_json(out);
+	out << ",\"overrun\":"; stats.overrun.write_json(out);
+	out << ",\"recv\":"; stats.recv.write_json(out);
+	out << ",\"update\":"; stats.update.write_json(out);
+	out << ",\"send\":"; stats.send.write_json(out);
+	out << "}";
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Connection.hpp"
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <cstdint>
+
+//Histogram of durations, in power-of-two microsecond buckets:
+// bucket 0 counts values under 1 us, bucket b (> 0) counts [2^(b-1), 2^b) us, and the last bucket everything longer.
+struct TickHistogram {
+	inline static constexpr uint32_t Buckets = 24; //(the last bucket starts at ~4 s)
+	std::array< uint64_t, Buckets > counts{};
+	uint64_t total = 0;
+	double max = 0.0; //(seconds)
+
+	void add(double seconds);
+	void clear();
+
+	//upper edge (seconds) of the bucket holding the value a fraction 'p' of the way through (0 if empty):
+	double percentile(double p) const;
+
+	//as {"total":..,"max_us":..,"buckets_us":[[upper edge, count], ...]} (empty buckets left out):
+	void write_json(std::ostream &out) const;
+};
+
+//Fixed-rate tick schedule for a RoomWorker: tick n is due at start + n * period, however late earlier ticks ran.
+//On linux the wait is a timerfd registered with the Server's epoll instance, so poll() returns within microseconds
+// of the deadline (rather than at the next whole millisecond of an epoll timeout); elsewhere the deadline is the poll timeout.
+struct TickScheduler {
+	//what to do when more than one tick is due (the worker fell behind):
+	enum class CatchUp : uint8_t {
+		Skip, //run one tick and drop the rest (the game clock falls behind wall-clock time)
+		Burst, //run the missed ticks back to back (at most MaxBurst -- beyond that they are dropped)
+	};
+	inline static constexpr uint32_t MaxBurst = 4;
+
+	TickScheduler(Server &server, double period, CatchUp catch_up);
+	~TickScheduler();
+	TickScheduler(TickScheduler const &) = delete;
+
+	//start the schedule over, with tick 1 due one period from now:
+	void restart();
+
+	//poll 'server' (passing 'on_event' along) until a tick is due; returns how many ticks to run now (at least one):
+	uint32_t wait(std::function< void(Connection *, Connection::Event event) > const &on_event);
+
+	//phase timings (seconds) for the ticks wait() returned, reported by the caller once they are done:
+	// (recv: handling client messages since the previous wait; update: stepping games; send: encoding and queueing snapshots)
+	void finish_ticks(double recv, double update, double send);
+
+	Server &server;
+	using Clock = std::chrono::steady_clock;
+	Clock::duration const period;
+	CatchUp const catch_up;
+	Clock::time_point start;
+	uint64_t slot = 0; //deadlines passed so far (run or dropped)
+
+	int timer_fd = -1; //(linux) timerfd firing every period, in server.epoll_fd
+
+	//stats (since the last clear_stats()):
+	struct Stats {
+		uint64_t ticks = 0; //ticks run
+		uint64_t late = 0; //times the worker woke up with more than one tick due
+		uint64_t dropped = 0; //ticks dropped by the catch-up policy
+		TickHistogram jitter; //how long after its deadline each tick started
+		TickHistogram overrun; //for ticks that ended after the next one was due: by how much
+		TickHistogram recv, update, send; //phase timings per tick
+	} stats;
+	void clear_stats();
+
+	//one line of JSON with the catch-up policy and all of 'stats':
+	void write_stats_json(std::ostream &out) const;
+};
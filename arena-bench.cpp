@@ -0,0 +1,134 @@
+//Arena benchmark: how a tick's cost grows with the number of balls in play.
+//For each ball count (doubling up to 'max_balls'), one seeded Arena is run for 'ticks' ticks with its spatial-hash broadphase,
+// then -- up to 'all_pairs_up_to' balls -- again checking every pair, which must end bit-identical (same Arena::hash()).
+//Also reports the packed snapshot size per ball, and checks it decodes.
+//
+//Both paddles are driven by a bot that follows the nearest ball coming its way.
+//
+//Links only Arena.cpp + the headless game code (no SDL / GL), so it can run on any box.
+
+#include "Arena.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cmath>
+
+//buttons for paddle 'index': follow the nearest ball heading for it:
+static void bot_controls(Arena &arena, uint32_t index) {
+	Player &player = arena.players[index];
+	float paddle_x = (index == 0 ? -Game::PlayerXPos : Game::PlayerXPos);
+	float best = INFINITY;
+	float target = 0.0f;
+	for (auto const &ball : arena.balls) {
+		bool incoming = (index == 0 ? ball.velocity.x < 0.0f : ball.velocity.x > 0.0f);
+		float distance = std::abs(ball.position.x - paddle_x);
+		if (incoming && distance < best) {
+			best = distance;
+			target = ball.position.y;
+		}
+	}
+	player.controls.up.pressed = (target > player.position + 2.0f);
+	player.controls.down.pressed = (target < player.position - 2.0f);
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+	//------------ argument parsing ------------
+
+	if (argc > 4) {
+		std::cerr << "Usage:\n\t./arena-bench [ticks=300] [max_balls=1024] [all_pairs_up_to=1024]" << std::endl;
+		return 1;
+	}
+	uint32_t ticks = (argc > 1 ? uint32_t(std::stoul(argv[1])) : 300);
+	uint32_t max_balls = (argc > 2 ? uint32_t(std::stoul(argv[2])) : 1024);
+	uint32_t all_pairs_up_to = (argc > 3 ? uint32_t(std::stoul(argv[3])) : 1024);
+	if (ticks == 0 || max_balls == 0) {
+		std::cerr << "Need at least one tick and one ball." << std::endl;
+		return 1;
+	}
+	max_balls = std::min(max_balls, Arena::MaxBalls);
+
+	constexpr uint64_t Seed = 0x20000;
+
+	using Clock = std::chrono::steady_clock;
+
+	struct Run {
+		double ns_per_tick = 0.0;
+		double mean_balls = 0.0;
+		uint64_t hash = 0;
+	};
+	auto run = [&](uint32_t balls, bool broadphase, Arena *out) {
+		Arena arena(Seed + balls, balls, std::max(4u, balls / 16));
+		arena.broadphase = broadphase;
+		Run result;
+		Clock::duration spent = Clock::duration::zero();
+		for (uint32_t t = 0; t < ticks; ++t) {
+			bot_controls(arena, 0);
+			bot_controls(arena, 1);
+			auto before = Clock::now();
+			arena.update(Game::Tick);
+			spent += Clock::now() - before;
+			result.mean_balls += double(arena.balls.size());
+		}
+		result.ns_per_tick = std::chrono::duration< double, std::nano >(spent).count() / ticks;
+		result.mean_balls /= ticks;
+		result.hash = arena.hash();
+		if (out) *out = arena;
+		return result;
+	};
+
+	std::cout << "---- arena benchmark (" << ticks << " ticks per run) ----\n" << std::fixed;
+	std::cout << "  balls | ns/tick     ns/ball | all pairs: ns/tick  speedup  | snapshot: bytes  bits/ball\n";
+
+	bool ok = true;
+	for (uint32_t balls = 16; balls <= max_balls; balls *= 2) {
+		Arena arena(0, 1, 0);
+		Run grid = run(balls, true, &arena);
+		std::cout << "  " << std::setw(5) << balls << " | "
+			<< std::setprecision(0) << std::setw(9) << grid.ns_per_tick << " "
+			<< std::setprecision(1) << std::setw(9) << grid.ns_per_tick / grid.mean_balls << " | ";
+
+		if (balls <= all_pairs_up_to) {
+			Run pairs = run(balls, false, nullptr);
+			bool match = (pairs.hash == grid.hash);
+			if (!match) ok = false;
+			std::cout << std::setprecision(0) << std::setw(18) << pairs.ns_per_tick << " "
+				<< std::setprecision(1) << std::setw(7) << pairs.ns_per_tick / grid.ns_per_tick << "x"
+				<< (match ? "" : " DOES NOT MATCH") << " | ";
+		} else {
+			std::cout << std::setw(28) << "(skipped)" << " | ";
+		}
+
+		std::vector< uint8_t > state;
+		arena.encode_state(&state);
+		Arena client(0, 1, 0);
+		client.decode_state(state);
+		if (client.balls.size() != arena.balls.size() || client.pads.size() != arena.pads.size()) {
+			std::cout << "snapshot DOES NOT DECODE\n";
+			ok = false;
+			continue;
+		}
+		std::cout << std::setw(15) << state.size() << " "
+			<< std::setprecision(1) << std::setw(10) << 8.0 * state.size() / double(arena.balls.size() + arena.pads.size())
+			<< "\n";
+	}
+	std::cout << "  (one absolutely-positioned point is " << Game::BitsX + Game::BitsY << " bits)\n";
+	std::cout.flush();
+
+	return (ok ? 0 : 1);
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
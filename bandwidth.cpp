@@ -0,0 +1,153 @@
+//Snapshot bandwidth report: records a headless match between two scripted
+// players (one full snapshot per tick, as the server would encode them), then
+// replays the recording through each state encoding, in full and as deltas
+// with the baseline a few ticks behind (as if acks took that long to arrive),
+// and compares the bytes sent per snapshot.
+//
+//Links only Connection.cpp + Game.cpp (no SDL / GL), so it can run on any box.
+
+#include "Connection.hpp"
+#include "Game.hpp"
+
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+	//------------ argument parsing ------------
+
+	if (argc > 2) {
+		std::cerr << "Usage:\n\t./bandwidth [seconds=120]" << std::endl;
+		return 1;
+	}
+	float seconds = (argc > 1 ? std::stof(argv[1]) : 120.0f);
+	if (seconds <= 0.0f) {
+		std::cerr << "Match length must be positive." << std::endl;
+		return 1;
+	}
+
+	//------------ record a match ------------
+
+	Game game(2); //(seeded, so every run reports on the same match)
+	Player *left = game.spawn_player();
+	Player *right = game.spawn_player();
+
+	std::mt19937 mt(0x15466);
+
+	//each paddle chases the ball, with some reaction slop so it misses now and then:
+	auto steer = [&](Player &player) {
+		float slop = std::uniform_real_distribution< float >(0.0f, Game::PlayerHeight)(mt);
+		player.controls.up.pressed = (game.BallPosition.y > player.position + slop);
+		player.controls.down.pressed = (game.BallPosition.y < player.position - slop);
+	};
+
+	//one recording per encoding:
+	std::vector< SharedBytes > recordings[Game::StateEncodings];
+	uint32_t ticks = uint32_t(seconds / Game::Tick);
+	for (auto &recording : recordings) recording.reserve(ticks);
+
+	float max_error = 0.0f; //largest position error after a packed round trip
+	Game decoded;
+	for (uint32_t t = 0; t < ticks; ++t) {
+		steer(*left);
+		steer(*right);
+		game.update(Game::Tick);
+		game.take_snapshot();
+		for (uint32_t e = 0; e < Game::StateEncodings; ++e) {
+			recordings[e].emplace_back(game.encode_state(StateEncoding(e)));
+		}
+
+		//check that the packed encoding keeps everything the client shows:
+		decoded.decode_state(*recordings[uint32_t(StateEncoding::Packed)].back(), StateEncoding::Packed);
+		max_error = std::max(max_error, glm::length(decoded.BallPosition - game.BallPosition));
+		auto d = decoded.players.begin();
+		for (auto const &player : game.players) {
+			max_error = std::max(max_error, std::abs(d->position - player.position));
+			if (d->score != player.score) {
+				std::cerr << "Packed snapshot at tick " << t << " has the wrong score!" << std::endl;
+				return 1;
+			}
+			++d;
+		}
+	}
+
+	//------------ replay through the encoders ------------
+
+	//(the per-connection header Game::send_state_message puts in front of every payload)
+	constexpr size_t Header = Game::StateHeaderSize;
+
+	uint64_t raw_full_bytes = 0;
+	for (auto const &state : recordings[uint32_t(StateEncoding::Raw)]) raw_full_bytes += Header + state->size();
+
+	std::cout << "---- snapshot bandwidth (" << ticks << " ticks, " << std::fixed << std::setprecision(1) << seconds << " s, "
+		<< game.players.front().score << " - " << game.players.back().score << ") ----\n";
+
+	//report one way of sending the recording (percentages are relative to full raw snapshots):
+	auto report = [&](std::string const &name, uint64_t bytes, uint32_t fallbacks) {
+		std::cout << "  " << std::left << std::setw(19) << name << std::right << ": "
+			<< std::setprecision(1) << std::setw(5) << double(bytes) / ticks << " B/snapshot, "
+			<< std::setprecision(2) << bytes / seconds / 1024.0 << " KiB/s per client, "
+			<< std::setprecision(0) << std::setw(3) << 100.0 * double(bytes) / double(raw_full_bytes) << "% of raw";
+		if (fallbacks) std::cout << ", " << fallbacks << " full fallbacks";
+		std::cout << "\n";
+	};
+
+	for (uint32_t e = 0; e < Game::StateEncodings; ++e) {
+		std::string encoding = (StateEncoding(e) == StateEncoding::Packed ? "packed" : "raw");
+		auto const &recording = recordings[e];
+
+		uint64_t full_bytes = 0;
+		for (auto const &state : recording) full_bytes += Header + state->size();
+		report(encoding + " full", full_bytes, 0);
+
+		std::vector< uint8_t > delta, applied;
+		for (uint32_t lag : {1u, 2u, 4u, 8u, 16u}) {
+			uint64_t bytes = 0;
+			uint32_t fallbacks = 0;
+			for (uint32_t t = 0; t < ticks; ++t) {
+				std::vector< uint8_t > const &state = *recording[t];
+				//(the first few ticks have nothing acked yet)
+				if (t < lag) {
+					bytes += Header + state.size();
+					fallbacks += 1;
+					continue;
+				}
+				std::vector< uint8_t > const &baseline = *recording[t - lag];
+				Game::delta_encode(baseline, state, &delta);
+				Game::delta_apply(baseline, delta, &applied);
+				if (applied != state) {
+					std::cerr << "Delta at tick " << t << " (" << encoding << ", lag " << lag << ") does not reproduce the snapshot!" << std::endl;
+					return 1;
+				}
+				if (delta.size() < state.size()) {
+					bytes += Header + delta.size();
+				} else {
+					bytes += Header + state.size();
+					fallbacks += 1;
+				}
+			}
+			report(encoding + " delta lag " + std::to_string(lag), bytes, fallbacks);
+		}
+	}
+	std::cout << "  packed position error: at most " << std::setprecision(4) << max_error << " (step " << Game::PositionStep << ")\n";
+	std::cout.flush();
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
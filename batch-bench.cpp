@@ -0,0 +1,132 @@
+//GameBatch benchmark: the same matches stepped
+// 1) one Game at a time, kept in a std::list (the way a server holding a Game per Room does it), and
+// 2) all together by GameBatch (with each vector kernel the CPU can run),
+//then checked against each other with Game::hash().
+//
+//Both players in every match are driven by a simple "follow the ball" bot, so matches see rallies, bounces, goals, and power-ups.
+//
+//Links only Game.cpp + GameBatch*.cpp (and the rest of the headless game code -- no SDL / GL), so it can run on any box.
+
+#include "Game.hpp"
+#include "GameBatch.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <list>
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+	//------------ argument parsing ------------
+
+	if (argc > 3) {
+		std::cerr << "Usage:\n\t./batch-bench [matches=4096] [ticks=1000]" << std::endl;
+		return 1;
+	}
+	uint32_t matches = (argc > 1 ? uint32_t(std::stoul(argv[1])) : 4096);
+	uint32_t ticks = (argc > 2 ? uint32_t(std::stoul(argv[2])) : 1000);
+	if (matches == 0 || ticks == 0) {
+		std::cerr << "Need at least one match and one tick." << std::endl;
+		return 1;
+	}
+
+	constexpr uint64_t Seed = 0x16000;
+
+	//buttons for a paddle at 'paddle' following a ball at 'ball':
+	struct Buttons {
+		bool up, down;
+	};
+	auto follow = [](float ball, float paddle) {
+		return Buttons{ball > paddle + 2.0f, ball < paddle - 2.0f};
+	};
+
+	using Clock = std::chrono::steady_clock;
+	auto ms_since = [](Clock::time_point start) {
+		return std::chrono::duration< double, std::milli >(Clock::now() - start).count();
+	};
+	double steps = double(matches) * ticks;
+
+	std::cout << "---- batch benchmark (" << matches << " matches x " << ticks << " ticks) ----\n" << std::fixed;
+
+	//------------ std::list< Game > ------------
+
+	std::list< Game > games;
+	double list_ms;
+	{
+		for (uint32_t i = 0; i < matches; ++i) {
+			games.emplace_back(Seed + i);
+			games.back().spawn_player();
+			games.back().spawn_player();
+		}
+
+		auto start = Clock::now();
+		for (uint32_t t = 0; t < ticks; ++t) {
+			for (auto &game : games) {
+				for (auto &player : game.players) {
+					Buttons b = follow(game.BallPosition.y, player.position);
+					player.controls.up.pressed = b.up;
+					player.controls.down.pressed = b.down;
+				}
+				game.update(Game::Tick);
+			}
+		}
+		list_ms = ms_since(start);
+		std::cout << "  std::list< Game >      : " << std::setprecision(0) << 1e3 * steps / list_ms << " match-steps/s ("
+			<< std::setprecision(1) << 1e6 * list_ms / steps << " ns/match-step)\n";
+	}
+
+	//------------ GameBatch ------------
+
+	bool ok = true;
+	bool try_avx2 = GameBatch(1, Seed).use_avx2;
+	for (bool avx2 : {true, false}) {
+		if (avx2 && !try_avx2) continue;
+
+		GameBatch batch(matches, Seed);
+		batch.use_avx2 = avx2;
+
+		auto start = Clock::now();
+		for (uint32_t t = 0; t < ticks; ++t) {
+			for (uint32_t i = 0; i < matches; ++i) {
+				float ball = batch.at(GameBatch::BallY, i);
+				Buttons b0 = follow(ball, batch.at(GameBatch::Position0, i));
+				Buttons b1 = follow(ball, batch.at(GameBatch::Position1, i));
+				batch.set_controls(i, 0, b0.up, b0.down);
+				batch.set_controls(i, 1, b1.up, b1.down);
+			}
+			batch.update(Game::Tick);
+		}
+		double batch_ms = ms_since(start);
+
+		uint32_t mismatched = 0;
+		auto game = games.begin();
+		for (uint32_t i = 0; i < matches; ++i, ++game) {
+			if (batch.scatter(i).hash() != game->hash()) mismatched += 1;
+		}
+		if (mismatched) ok = false;
+
+		std::cout << "  GameBatch (" << std::setw(8) << std::left << batch.kernel() << std::right << ")   : "
+			<< std::setprecision(0) << 1e3 * steps / batch_ms << " match-steps/s ("
+			<< std::setprecision(1) << 1e6 * batch_ms / steps << " ns/match-step), "
+			<< std::setprecision(2) << list_ms / batch_ms << "x, "
+			<< std::setprecision(1) << 100.0 * batch.lanes_fallback / double(batch.lanes_fallback + batch.lanes_stepped) << "% of match-steps fell back to Game::update(), "
+			<< (mismatched ? std::to_string(mismatched) + " matches DO NOT MATCH" : std::string("all matches match")) << "\n";
+	}
+	std::cout.flush();
+
+	return (ok ? 0 : 1);
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
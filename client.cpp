@@ -36,13 +36,37 @@ int main(int argc, char **argv) {
 	try {
 #endif
 	//------------ command line arguments ------------
-	if (argc != 3) {
-		std::cerr << "Usage:\n\t./client <host> <port>" << std::endl;
+	auto usage = []() {
+		std::cerr << "Usage:\n\t./client <host> <port> [tcp|udp] [interpolation delay (ms)]" << std::endl;
 		return 1;
+	};
+	if (argc < 3 || argc > 5) return usage();
+
+	Transport transport = Transport::Stream;
+	if (argc >= 4) {
+		if (std::string(argv[3]) == "udp") transport = Transport::Datagram;
+		else if (std::string(argv[3]) != "tcp") {
+			std::cerr << "Unknown transport '" << argv[3] << "' (expecting 'tcp' or 'udp')." << std::endl;
+			return 1;
+		}
+	}
+
+	//how far behind the newest snapshot to draw the ball and remote paddles (negative means use the default):
+	float interpolation_delay = -1.0f;
+	if (argc >= 5) {
+		try {
+			interpolation_delay = std::stof(argv[4]) / 1000.0f;
+		} catch (std::logic_error const &) { //(std::invalid_argument or std::out_of_range -- e.g., for '--help')
+			return usage();
+		}
+		if (interpolation_delay < 0.0f) {
+			std::cerr << "Interpolation delay can't be negative." << std::endl;
+			return 1;
+		}
 	}
 
 	//------------ connect to server --------------
-	Client client(argv[1], argv[2]);
+	Client client(argv[1], argv[2], PollBackend::Select, transport);
 
 	//------------  initialization ------------
 
@@ -113,7 +137,9 @@ int main(int argc, char **argv) {
 	call_load_functions();
 
 	//------------ create game mode + make current --------------
-	Mode::set_current(std::make_shared< PlayMode >(client));
+	auto play = std::make_shared< PlayMode >(client);
+	if (interpolation_delay >= 0.0f) play->snapshots.delay = play->fixed_delay = interpolation_delay;
+	Mode::set_current(play);
 
 	//------------ main loop ------------
 
@@ -0,0 +1,353 @@
+//Headless load generator: opens many bot connections to a server, sends
+// scripted or random controls, decodes the state snapshots that come back,
+// and reports snapshot timing, round-trip times, throughput, and disconnects.
+//
+//Links only Connection.cpp + Game.cpp (no SDL / GL), so it can run on any box.
+
+#include "Connection.hpp"
+#include "Game.hpp"
+#include "Prediction.hpp"
+#include "Interpolation.hpp"
+#include "ClockSync.hpp"
+
+#include <chrono>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <list>
+
+//one simulated player:
+struct Bot {
+	Bot(std::string const &host, std::string const &port, Transport transport) :
+		#ifdef __linux__
+		//(select() can't handle socket numbers past FD_SETSIZE, which thousands of bots will reach)
+		client(host, port, PollBackend::Epoll, transport)
+		#else
+		client(host, port, PollBackend::Select, transport)
+		#endif
+		{ }
+
+	Client client;
+	Game game; //latest state from server
+	Player::Controls controls;
+	Prediction prediction; //(as the real client would predict its paddle)
+	SnapshotBuffer snapshots; //(and interpolate everything else)
+	SnapshotBuffer::View view;
+	ClockSync clock; //(and ping the server)
+	bool connected = true;
+
+	std::chrono::steady_clock::time_point last_snapshot;
+	bool have_snapshot = false;
+
+	//random input state:
+	float hold = 0.0f; //seconds left to hold current buttons
+};
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+	//------------ argument parsing ------------
+
+	auto usage = []() {
+		std::cerr << "Usage:\n\t./loadgen <host> <port> [clients=100] [rate_hz=60] [seconds=30] [inputs=random|sweep|idle] [transport=tcp|udp] [encoding=raw|packed] [interp_delay_ms=2 snapshot intervals] [snapshot_hz=0 (every tick)]" << std::endl;
+		return 1;
+	};
+	if (argc < 3 || argc > 11) return usage();
+	std::string host = argv[1];
+	std::string port = argv[2];
+	uint32_t client_count;
+	float rate, seconds;
+	try {
+		client_count = (argc > 3 ? uint32_t(std::stoul(argv[3])) : 100);
+		rate = (argc > 4 ? std::stof(argv[4]) : 60.0f);
+		seconds = (argc > 5 ? std::stof(argv[5]) : 30.0f);
+	} catch (std::logic_error const &) { //(std::invalid_argument or std::out_of_range -- e.g., for '--help')
+		return usage();
+	}
+	std::string inputs = (argc > 6 ? argv[6] : "random");
+	if (inputs != "random" && inputs != "sweep" && inputs != "idle") {
+		std::cerr << "Unknown input pattern '" << inputs << "'." << std::endl;
+		return 1;
+	}
+	std::string transport_name = (argc > 7 ? argv[7] : "tcp");
+	if (transport_name != "tcp" && transport_name != "udp") {
+		std::cerr << "Unknown transport '" << transport_name << "'." << std::endl;
+		return 1;
+	}
+	Transport transport = (transport_name == "udp" ? Transport::Datagram : Transport::Stream);
+	std::string encoding_name = (argc > 8 ? argv[8] : "raw");
+	if (encoding_name != "raw" && encoding_name != "packed") {
+		std::cerr << "Unknown state encoding '" << encoding_name << "'." << std::endl;
+		return 1;
+	}
+	StateEncoding encoding = (encoding_name == "packed" ? StateEncoding::Packed : StateEncoding::Raw);
+	//(by default, two snapshot intervals -- set once the server says what those are)
+	bool fixed_delay = (argc > 9);
+	float interpolation_delay = SnapshotBuffer().delay;
+	//snapshot rate each bot asks for (the server rounds it to a whole number of ticks):
+	uint32_t snapshot_rate = 0;
+	try {
+		if (fixed_delay) interpolation_delay = std::stof(argv[9]) / 1000.0f;
+		if (argc > 10) snapshot_rate = uint32_t(std::stoul(argv[10]));
+	} catch (std::logic_error const &) { //(std::invalid_argument or std::out_of_range)
+		return usage();
+	}
+	if (interpolation_delay < 0.0f) {
+		std::cerr << "Interpolation delay can't be negative." << std::endl;
+		return 1;
+	}
+	if (snapshot_rate > 255) {
+		std::cerr << "Snapshot rate can be at most 255 Hz." << std::endl;
+		return 1;
+	}
+	if (rate <= 0.0f) {
+		std::cerr << "Send rate must be positive." << std::endl;
+		return 1;
+	}
+
+	//------------ connect bots ------------
+
+	std::list< Bot > bots;
+	for (uint32_t i = 0; i < client_count; ++i) {
+		bots.emplace_back(host, port, transport);
+		//pick the state encoding (acks nothing yet):
+		bots.back().game.state_encoding = encoding;
+		bots.back().game.state_send_rate = uint8_t(snapshot_rate);
+		bots.back().snapshots.delay = interpolation_delay;
+		bots.back().game.send_state_ack_message(&bots.back().client.connection);
+	}
+	std::cout << "Connected " << bots.size() << " bots." << std::endl;
+
+	//------------ main loop ------------
+
+	std::mt19937 mt(0x15466);
+
+	//stats:
+	std::vector< float > intervals; //time between consecutive snapshots on one connection (ms)
+	std::vector< float > prediction_errors; //how far off each predicted paddle was when its snapshot arrived
+	std::vector< float > rtts; //every ping's round trip (ms)
+	uint64_t snapshots = 0;
+	uint64_t bytes_recv = 0;
+	uint64_t bytes_sent = 0;
+	uint32_t disconnects = 0;
+
+	//handlers for messages from the server ('receiving' is the bot whose connection is being handled):
+	Bot *receiving = nullptr;
+	MessageDispatch dispatch;
+	dispatch.on(Message::S2C_State, [&](RingBuffer const &buffer, MessageView const &message) {
+		Bot &bot = *receiving;
+		auto at = std::chrono::steady_clock::now();
+		if (!bot.game.recv_state_message(buffer, message)) return; //(skipped behind a newer one)
+		bot.snapshots.push(bot.game, at);
+		if (bot.have_snapshot) {
+			intervals.emplace_back(std::chrono::duration< float, std::milli >(at - bot.last_snapshot).count());
+		}
+		bot.last_snapshot = at;
+		bot.have_snapshot = true;
+		snapshots += 1;
+	});
+	dispatch.on(Message::S2C_Pong, [&](MessageView const &message) {
+		Bot &bot = *receiving;
+		uint32_t samples = bot.clock.sample_count;
+		bot.clock.recv_pong_message(message, std::chrono::steady_clock::now());
+		if (bot.clock.sample_count != samples) {
+			rtts.emplace_back(bot.clock.samples[samples % ClockSync::Window].rtt * 1000.0f);
+		}
+	});
+	dispatch.on(Message::S2C_Rates, [&](MessageView const &message) {
+		Bot &bot = *receiving;
+		bot.game.recv_rates_message(message);
+		float interval = bot.game.tick * float(bot.game.state_send_interval);
+		if (!fixed_delay) {
+			interpolation_delay = 2.0f * interval;
+			bot.snapshots.delay = interpolation_delay;
+		}
+		//(either way, keep things moving through one missing snapshot)
+		bot.snapshots.max_extrapolation = interval;
+	});
+
+	auto const send_period = std::chrono::duration_cast< std::chrono::steady_clock::duration >(std::chrono::duration< double >(1.0 / rate));
+	auto const start = std::chrono::steady_clock::now();
+	auto const end = start + std::chrono::duration_cast< std::chrono::steady_clock::duration >(std::chrono::duration< double >(seconds));
+	auto next_send = start;
+	auto next_report = start + std::chrono::seconds(1);
+	uint64_t report_bytes = 0;
+
+	while (std::chrono::steady_clock::now() < end) {
+		auto now = std::chrono::steady_clock::now();
+
+		//queue controls for every bot:
+		if (now >= next_send) {
+			float elapsed = std::chrono::duration< float >(send_period).count();
+			next_send += send_period;
+			if (next_send < now) next_send = now + send_period; //don't try to catch up after a stall
+
+			float t = std::chrono::duration< float >(now - start).count();
+			for (auto &bot : bots) {
+				if (!bot.connected) continue;
+				bool up = false, down = false;
+				if (inputs == "random") {
+					//hold a random choice of buttons for a random while:
+					bot.hold -= elapsed;
+					if (bot.hold <= 0.0f) {
+						bot.hold = std::uniform_real_distribution< float >(0.1f, 0.8f)(mt);
+						uint32_t choice = mt() % 3;
+						up = (choice == 0);
+						down = (choice == 1);
+						if (up && !bot.controls.up.pressed) bot.controls.up.downs += 1;
+						if (down && !bot.controls.down.pressed) bot.controls.down.downs += 1;
+						bot.controls.up.pressed = up;
+						bot.controls.down.pressed = down;
+					}
+				} else if (inputs == "sweep") {
+					//alternate up / down every second:
+					up = (int32_t(t) % 2 == 0);
+					down = !up;
+					if (up && !bot.controls.up.pressed) bot.controls.up.downs += 1;
+					if (down && !bot.controls.down.pressed) bot.controls.down.downs += 1;
+					bot.controls.up.pressed = up;
+					bot.controls.down.pressed = down;
+				}
+				bot.controls.seq += 1;
+				bot.controls.tick = (bot.clock.synced ? bot.clock.server_tick(now, bot.game.tick) : bot.snapshots.server_tick(now));
+				bot.controls.send_controls_message(&bot.client.connection);
+				//(over udp controls skip the send buffer, so count the message itself: header, seq, tick, count, 3 bytes per input)
+				bytes_sent += 4 + 4 + 4 + 1 + 3 * bot.controls.sent_count;
+				bot.prediction.apply(bot.controls, elapsed);
+				//(sends happen at about the rate a client would render)
+				bot.snapshots.sample(now, &bot.view);
+				bot.controls.up.downs = 0;
+				bot.controls.down.downs = 0;
+			}
+		}
+
+		//send/receive data:
+		for (auto &bot : bots) {
+			if (!bot.connected) continue;
+			bot.clock.update(&bot.client.connection, now);
+			bot.client.poll([&](Connection *c, Connection::Event event) {
+				if (event == Connection::OnClose) {
+					bot.connected = false;
+					disconnects += 1;
+				} else if (event == Connection::OnRecv) {
+					//(over udp, snapshots arrive on the unreliable channel)
+					size_t before = c->recv_buffer.size() + c->unreliable_recv_buffer.size();
+					uint32_t state_seq = bot.game.state_seq;
+					try {
+						receiving = &bot;
+						dispatch.dispatch(c);
+						if (bot.game.state_seq != state_seq) {
+							bot.game.send_state_ack_message(c);
+							bool predicting = bot.prediction.active;
+							bot.prediction.reconcile(bot.game);
+							if (predicting) prediction_errors.emplace_back(std::abs(bot.prediction.last_error));
+						}
+					} catch (std::exception const &e) {
+						std::cerr << "[" << c->socket << "] malformed message from server: " << e.what() << std::endl;
+						c->close();
+						bot.connected = false;
+						disconnects += 1;
+					}
+					bytes_recv += before - (c->recv_buffer.size() + c->unreliable_recv_buffer.size());
+				}
+			}, 0.0);
+		}
+
+		if (now >= next_report) {
+			next_report += std::chrono::seconds(1);
+			uint32_t connected = 0;
+			for (auto const &bot : bots) connected += (bot.connected ? 1 : 0);
+			std::cout << "  t=" << std::fixed << std::setprecision(0) << std::chrono::duration< float >(now - start).count() << "s"
+				<< " connected " << connected
+				<< " snapshots " << snapshots
+				<< " recv " << std::setprecision(1) << (bytes_recv - report_bytes) / 1024.0 << " KiB/s" << std::endl;
+			report_bytes = bytes_recv;
+		}
+
+		//wait a little bit (but not past the next send):
+		auto wait = std::min(next_send - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration(std::chrono::milliseconds(1)));
+		if (wait.count() > 0) std::this_thread::sleep_for(wait);
+	}
+
+	//------------ report ------------
+
+	float total = std::chrono::duration< float >(std::chrono::steady_clock::now() - start).count();
+	std::cout << "---- loadgen summary ----\n";
+	std::cout << "bots: " << client_count << ", transport: " << transport_name << ", encoding: " << encoding_name << ", inputs: " << inputs << ", send rate: " << rate << " Hz, duration: " << std::setprecision(1) << total << " s\n";
+	std::cout << "disconnects: " << disconnects << "\n";
+	{
+		uint64_t skipped_states = 0;
+		for (auto const &bot : bots) skipped_states += bot.game.skipped_states;
+		std::cout << "snapshots: " << snapshots << " (" << snapshots / total << "/s), " << skipped_states << " more dropped unread behind newer ones\n";
+	}
+	std::cout << "recv: " << bytes_recv / total / 1024.0 << " KiB/s, sent: " << bytes_sent / total / 1024.0 << " KiB/s\n";
+	//(sorts 'values'):
+	auto percentile = [](std::vector< float > &values, float p) {
+		std::sort(values.begin(), values.end());
+		return values[std::min(values.size() - 1, size_t(p * values.size()))];
+	};
+	if (!intervals.empty()) {
+		std::cout << "snapshot interval (ms): p50 " << std::setprecision(2) << percentile(intervals, 0.5f)
+			<< ", p90 " << percentile(intervals, 0.9f)
+			<< ", p99 " << percentile(intervals, 0.99f)
+			<< ", max " << intervals.back()
+			<< " (ideal " << bots.front().game.tick * float(bots.front().game.state_send_interval) * 1000.0f << ")\n";
+	}
+	{
+		uint32_t starvation_events = 0;
+		float starved_time = 0.0f, extrapolated_time = 0.0f;
+		for (auto const &bot : bots) {
+			starvation_events += bot.snapshots.starvation_events;
+			starved_time += bot.snapshots.starved_time;
+			extrapolated_time += bot.snapshots.extrapolated_time;
+		}
+		float bot_time = total * bots.size();
+		std::cout << "snapshot buffer (delay " << std::setprecision(0) << interpolation_delay * 1000.0f << " ms): "
+			<< std::setprecision(1) << starvation_events / (bot_time / 60.0f) << " starvation events per bot-minute, "
+			<< std::setprecision(2) << 100.0f * starved_time / bot_time << "% of time starved ("
+			<< 100.0f * extrapolated_time / bot_time << "% extrapolated)\n";
+	}
+	if (!prediction_errors.empty()) {
+		std::cout << "paddle prediction error (units): p50 " << std::setprecision(3) << percentile(prediction_errors, 0.5f)
+			<< ", p90 " << percentile(prediction_errors, 0.9f)
+			<< ", p99 " << percentile(prediction_errors, 0.99f)
+			<< ", max " << prediction_errors.back()
+			<< " (paddle half-height " << Game::PlayerHeight << ")\n";
+	}
+	if (!rtts.empty()) {
+		std::cout << "ping round trip (ms): p50 " << std::setprecision(2) << percentile(rtts, 0.5f)
+			<< ", p90 " << percentile(rtts, 0.9f)
+			<< ", p99 " << percentile(rtts, 0.99f)
+			<< ", max " << rtts.back() << "\n";
+	}
+	//how old each bot's newest snapshot was when it arrived, by the synced clock (about half the round trip if the clocks agree):
+	std::vector< float > ages;
+	for (auto const &bot : bots) {
+		if (!bot.clock.synced || !bot.have_snapshot) continue;
+		ages.emplace_back(float(bot.clock.server_time(bot.last_snapshot) - double(bot.game.state_seq) * double(bot.game.tick)) * 1000.0f);
+	}
+	if (!ages.empty()) {
+		std::cout << "snapshot age on arrival (ms): p50 " << std::setprecision(2) << percentile(ages, 0.5f)
+			<< ", min " << ages.front()
+			<< ", max " << ages.back() << "\n";
+	}
+	std::cout.flush();
+
+	return (disconnects == 0 ? 0 : 2);
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
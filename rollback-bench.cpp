@@ -0,0 +1,240 @@
+//Rollback microbenchmark:
+// 1) raw Game::update() throughput, and the cost of saving / restoring a Game::Frame
+//    (a rollback re-simulates up to Rollback::MaxRollback ticks inside one client frame, so this needs to be well over 1000 ticks/ms);
+// 2) two Rollback peers playing each other through in-memory connections that delay and drop messages,
+//    checked against a reference game run with the real inputs, with the cost of each advance().
+//
+//Links only Connection.cpp + Game.cpp + Rollback.cpp (no SDL / GL), so it can run on any box.
+
+#include "Connection.hpp"
+#include "Game.hpp"
+#include "Rollback.hpp"
+
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+	//------------ argument parsing ------------
+
+	auto usage = []() {
+		std::cerr << "Usage:\n\t./rollback-bench [ticks=100000] [max_delay_ticks=6]" << std::endl;
+		return 1;
+	};
+	if (argc > 3) return usage();
+	uint32_t ticks, max_delay;
+	try {
+		ticks = (argc > 1 ? uint32_t(std::stoul(argv[1])) : 100000);
+		max_delay = (argc > 2 ? uint32_t(std::stoul(argv[2])) : 6);
+	} catch (std::logic_error const &) { //(std::invalid_argument or std::out_of_range -- e.g., for '--help')
+		return usage();
+	}
+	if (ticks == 0) {
+		std::cerr << "Need at least one tick." << std::endl;
+		return 1;
+	}
+	if (max_delay >= Rollback::MaxRollback) {
+		std::cerr << "Delays of " << Rollback::MaxRollback << " ticks or more would just stall." << std::endl;
+		return 1;
+	}
+
+	constexpr uint64_t Seed = 0x15466;
+	std::mt19937 mt(0x15466);
+
+	//buttons that stay the same for a random while (like a person playing):
+	struct Script {
+		Rollback::Input input;
+		uint32_t hold = 0;
+		Rollback::Input next(std::mt19937 &mt) {
+			if (hold == 0) {
+				uint32_t choice = std::uniform_int_distribution< uint32_t >(0, 2)(mt);
+				input.up = (choice == 0);
+				input.down = (choice == 1);
+				hold = std::uniform_int_distribution< uint32_t >(1, 20)(mt);
+			}
+			hold -= 1;
+			return input;
+		}
+	};
+
+	using Clock = std::chrono::steady_clock;
+	auto ms_since = [](Clock::time_point start) {
+		return std::chrono::duration< double, std::milli >(Clock::now() - start).count();
+	};
+
+	bool ok = true;
+
+	//------------ raw simulation speed ------------
+
+	std::cout << "---- rollback benchmark (" << ticks << " ticks) ----\n" << std::fixed;
+	{
+		Game game(Seed);
+		Player *players[2] = {game.spawn_player(), game.spawn_player()};
+		std::vector< Rollback::Input > inputs(2 * size_t(ticks));
+		Script scripts[2];
+		for (uint32_t p = 0; p < 2; ++p) {
+			for (uint32_t t = 0; t < ticks; ++t) inputs[p * size_t(ticks) + t] = scripts[p].next(mt);
+		}
+
+		auto start = Clock::now();
+		for (uint32_t t = 0; t < ticks; ++t) {
+			for (uint32_t p = 0; p < 2; ++p) {
+				players[p]->controls.up.pressed = inputs[p * size_t(ticks) + t].up;
+				players[p]->controls.down.pressed = inputs[p * size_t(ticks) + t].down;
+			}
+			game.update(Game::Tick);
+		}
+		double update_ms = ms_since(start);
+		double rate = ticks / update_ms;
+
+		Game::Frame frame;
+		start = Clock::now();
+		for (uint32_t t = 0; t < ticks; ++t) {
+			game.save(&frame);
+			game.restore(frame);
+		}
+		double save_ms = ms_since(start);
+
+		std::cout << "  Game::update           : " << std::setprecision(0) << rate << " ticks/ms (" << std::setprecision(1) << 1e6 * update_ms / ticks << " ns/tick, "
+			<< game.players.front().score << " - " << game.players.back().score << ") -- " << (rate >= 1000.0 ? "ok" : "TOO SLOW") << " (need 1000)\n";
+		std::cout << "  save + restore         : " << std::setprecision(1) << 1e6 * save_ms / ticks << " ns (Frame is " << sizeof(Game::Frame) << " bytes)\n";
+		std::cout << "  worst-case rollback    : " << std::setprecision(3) << Rollback::MaxRollback * update_ms / ticks + save_ms / ticks << " ms ("
+			<< Rollback::MaxRollback << " ticks)\n";
+		if (rate < 1000.0) ok = false;
+	}
+
+	//------------ two peers ------------
+
+	{
+		Rollback peers[2] = {Rollback(Seed, 0), Rollback(Seed, 1)};
+		//(connections without sockets: messages pile up in send_buffer and get delivered by hand below)
+		Connection links[2];
+		struct InFlight {
+			uint32_t deliver_at; //frame
+			std::vector< uint8_t > bytes;
+		};
+		std::deque< InFlight > in_flight[2]; //(messages on the way to peer i)
+		uint32_t dropped = 0;
+
+		Script scripts[2];
+		Rollback::Input next_input[2] = {scripts[0].next(mt), scripts[1].next(mt)}; //(held until the peer isn't stalled)
+		std::vector< Rollback::Input > played[2]; //local inputs each peer actually simulated, by tick
+		std::vector< double > advance_us;
+
+		//pass messages sent by peer 'from' into the network:
+		auto send = [&](uint32_t from, uint32_t frame, bool reliable) {
+			auto &buffer = links[from].send_buffer;
+			while (buffer.size() >= 4) {
+				uint32_t size = 4 + ((uint32_t(buffer[3]) << 16) | (uint32_t(buffer[2]) << 8) | uint32_t(buffer[1]));
+				InFlight message;
+				message.deliver_at = frame + (reliable ? 0 : std::uniform_int_distribution< uint32_t >(0, max_delay)(mt));
+				message.bytes.resize(size);
+				buffer.copy_out(0, message.bytes.data(), size);
+				buffer.consume(size);
+				if (!reliable && std::uniform_real_distribution< float >(0.0f, 1.0f)(mt) < 0.1f) {
+					dropped += 1;
+					continue;
+				}
+				in_flight[1 - from].emplace_back(std::move(message));
+			}
+		};
+		//deliver messages for peer 'to' that are due (in any order they happen to be due -- later ones repeat what earlier ones said):
+		auto deliver = [&](uint32_t to, uint32_t frame) {
+			auto &queue = in_flight[to];
+			for (auto m = queue.begin(); m != queue.end(); ) {
+				if (m->deliver_at > frame) {
+					++m;
+					continue;
+				}
+				RingBuffer buffer;
+				buffer.append(m->bytes.data(), m->bytes.size());
+				while (peers[to].recv_input_message(buffer)) { }
+				m = queue.erase(m);
+			}
+		};
+
+		uint32_t frame = 0;
+		while (peers[0].tick < ticks || peers[1].tick < ticks) {
+			frame += 1;
+			for (uint32_t p = 0; p < 2; ++p) {
+				deliver(p, frame);
+				if (peers[p].tick < ticks) {
+					auto start = Clock::now();
+					bool advanced = peers[p].advance(next_input[p]);
+					advance_us.emplace_back(1000.0 * ms_since(start));
+					if (advanced) {
+						played[p].emplace_back(next_input[p]);
+						next_input[p] = scripts[p].next(mt);
+					}
+				}
+				peers[p].send_input_message(&links[p]);
+				send(p, frame, false);
+			}
+		}
+
+		//let the last inputs through (reliably, now) and settle both peers on the final state:
+		for (uint32_t round = 0; round < 4; ++round) {
+			frame += max_delay + 1;
+			for (uint32_t p = 0; p < 2; ++p) {
+				deliver(p, frame);
+				peers[p].send_input_message(&links[p]);
+				send(p, frame, true);
+			}
+		}
+		for (auto &peer : peers) {
+			if (peer.remote_confirmed != ticks) {
+				std::cerr << "Peer " << int(peer.local_player) << " only confirmed " << peer.remote_confirmed << " of " << ticks << " remote inputs!" << std::endl;
+				return 1;
+			}
+			peer.settle();
+		}
+
+		//the same match, with every input known up front:
+		Game reference(Seed);
+		Player *players[2] = {reference.spawn_player(), reference.spawn_player()};
+		for (uint32_t t = 0; t < ticks; ++t) {
+			for (uint32_t p = 0; p < 2; ++p) {
+				players[p]->controls.up.pressed = played[p][t].up;
+				players[p]->controls.down.pressed = played[p][t].down;
+			}
+			reference.update(Game::Tick);
+		}
+
+		bool match = (peers[0].game.hash() == reference.hash() && peers[1].game.hash() == reference.hash());
+		if (!match) ok = false;
+
+		std::sort(advance_us.begin(), advance_us.end());
+		auto percentile = [&](float p) { return advance_us[std::min(advance_us.size() - 1, size_t(p * advance_us.size()))]; };
+
+		std::cout << "  peers (delay 0-" << max_delay << " ticks, 10% loss): " << frame << " frames, " << dropped << " messages dropped\n";
+		for (auto const &peer : peers) {
+			std::cout << "    player " << int(peer.local_player) << ": " << peer.rollbacks << " rollbacks, "
+				<< std::setprecision(1) << (peer.rollbacks ? double(peer.resimulated_ticks) / peer.rollbacks : 0.0) << " ticks deep on average, "
+				<< peer.max_rollback << " max, " << peer.stalls << " stalls\n";
+		}
+		std::cout << "    advance() (us): p50 " << std::setprecision(2) << percentile(0.5f) << ", p99 " << percentile(0.99f) << ", max " << advance_us.back() << "\n";
+		std::cout << "    final state: " << (match ? "matches" : "DOES NOT MATCH") << " the reference (hash " << std::hex << reference.hash() << std::dec << ")\n";
+	}
+	std::cout.flush();
+
+	return (ok ? 0 : 1);
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -1,15 +1,13 @@
 
-#include "Connection.hpp"
+#include "Room.hpp"
 
-#include "hex_dump.hpp"
-
-#include "Game.hpp"
-
-#include <chrono>
 #include <stdexcept>
 #include <iostream>
-#include <cassert>
-#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <list>
+#include <vector>
+#include <string>
 
 #ifdef _WIN32
 extern "C" { uint32_t GetACP(); }
@@ -32,89 +30,85 @@ int main(int argc, char **argv) {
 
 	//------------ argument parsing ------------
 
-	if (argc != 2) {
-		std::cerr << "Usage:\n\t./server <port>" << std::endl;
+	auto usage = []() {
+		std::cerr << "Usage:\n\t./server <port> [workers] [tcp|udp] [burst|skip] [tick_hz=" << int(1.0f / Game::Tick + 0.5f) << "]" << std::endl;
 		return 1;
+	};
+	if (argc < 2 || argc > 6) return usage();
+
+	//each worker thread runs its own event loop over its own rooms:
+	#ifdef __linux__
+	uint32_t workers = std::max(1U, std::thread::hardware_concurrency());
+	#else
+	uint32_t workers = 1; //(port sharing between workers needs linux)
+	#endif
+	if (argc >= 3) {
+		try {
+			workers = uint32_t(std::stoul(argv[2]));
+		} catch (std::logic_error const &) { //(std::invalid_argument or std::out_of_range -- e.g., for '--help')
+			return usage();
+		}
+		if (workers == 0) {
+			std::cerr << "Need at least one worker." << std::endl;
+			return 1;
+		}
 	}
 
-	//------------ initialization ------------
-
-	Server server(argv[1]);
-
-	//------------ main loop ------------
-
-	//keep track of which connection is controlling which player:
-	std::unordered_map< Connection *, Player * > connection_to_player;
-	//keep track of game state:
-	Game game;
-
-	while (true) {
-		static auto next_tick = std::chrono::steady_clock::now() + std::chrono::duration< double >(Game::Tick);
-		//process incoming data from clients until a tick has elapsed:
-		while (true) {
-			auto now = std::chrono::steady_clock::now();
-			double remain = std::chrono::duration< double >(next_tick - now).count();
-			if (remain < 0.0) {
-				next_tick += std::chrono::duration< double >(Game::Tick);
-				break;
-			}
-
-			//helper used on client close (due to quit) and server close (due to error):
-			auto remove_connection = [&](Connection *c) {
-				auto f = connection_to_player.find(c);
-				assert(f != connection_to_player.end());
-				game.remove_player(f->second);
-				connection_to_player.erase(f);
-			};
-
-			server.poll([&](Connection *c, Connection::Event evt){
-				if (evt == Connection::OnOpen) {
-					//client connected:
-
-					//create some player info for them:
-					connection_to_player.emplace(c, game.spawn_player());
-
-				} else if (evt == Connection::OnClose) {
-					//client disconnected:
-
-					remove_connection(c);
-
-				} else { assert(evt == Connection::OnRecv);
-					//got data from client:
-					//std::cout << "current buffer:\n" << hex_dump(c->recv_buffer); std::cout.flush(); //DEBUG
-
-					//look up in players list:
-					auto f = connection_to_player.find(c);
-					assert(f != connection_to_player.end());
-					Player &player = *f->second;
-
-					//handle messages from client:
-					try {
-						bool handled_message;
-						do {
-							handled_message = false;
-							if (player.controls.recv_controls_message(c)) handled_message = true;
-							//TODO: extend for more message types as needed
-						} while (handled_message);
-					} catch (std::exception const &e) {
-						std::cout << "Disconnecting client:" << e.what() << std::endl;
-						c->close();
-						remove_connection(c);
-					}
-				}
-			}, remain);
+	//state snapshots can go over udp so a lost packet doesn't stall the ones after it:
+	Transport transport = Transport::Stream;
+	if (argc >= 4) {
+		if (std::string(argv[3]) == "udp") transport = Transport::Datagram;
+		else if (std::string(argv[3]) != "tcp") {
+			std::cerr << "Unknown transport '" << argv[3] << "' (expecting 'tcp' or 'udp')." << std::endl;
+			return 1;
 		}
+	}
 
-		//update current game state
-		game.update(Game::Tick);
+	//a worker that falls behind either runs the missed ticks back to back, or drops them (see TickScheduler):
+	TickScheduler::CatchUp catch_up = TickScheduler::CatchUp::Burst;
+	if (argc >= 5) {
+		if (std::string(argv[4]) == "skip") catch_up = TickScheduler::CatchUp::Skip;
+		else if (std::string(argv[4]) != "burst") {
+			std::cerr << "Unknown catch-up policy '" << argv[4] << "' (expecting 'burst' or 'skip')." << std::endl;
+			return 1;
+		}
+	}
 
-		//send updated game state to all clients
-		for (auto &[c, player] : connection_to_player) {
-			game.send_state_message(c);
+	//simulation rate (independent of how often each client gets snapshots -- they ask for that themselves, see Game::state_send_rate):
+	float tick = Game::Tick;
+	if (argc >= 6) {
+		float hz;
+		try {
+			hz = std::stof(argv[5]);
+		} catch (std::logic_error const &) { //(std::invalid_argument or std::out_of_range)
+			return usage();
+		}
+		if (!(hz >= 1.0f && hz <= 1000.0f)) {
+			std::cerr << "Tick rate must be between 1 and 1000 Hz." << std::endl;
+			return 1;
 		}
+		tick = 1.0f / hz;
+	}
+
+	//------------ initialization ------------
 
+	//(workers are created up front so a port that can't be bound is reported before any threads start)
+	std::list< RoomWorker > room_workers;
+	for (uint32_t i = 0; i < workers; ++i) {
+		room_workers.emplace_back(argv[1], i, workers > 1, transport, catch_up, tick);
 	}
 
+	//------------ main loop ------------
+
+	std::cout << "Hosting rooms on " << workers << " worker thread(s), ticking at " << 1.0f / tick << " Hz." << std::endl;
+
+	std::vector< std::thread > threads;
+	for (auto &worker : room_workers) {
+		threads.emplace_back([&worker](){ worker.run(); });
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
 
 	return 0;
 
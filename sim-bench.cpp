@@ -0,0 +1,303 @@
+//Self-play simulation benchmark: many seeded matches, every paddle driven by a track-the-ball bot through Player::Controls,
+// stepped with Game::update() for a fixed number of ticks. Reports throughput, per-update cost percentiles, and heap allocations per update,
+// as one line of JSON on stdout (so runs can be kept and compared across versions; a readable summary goes to stderr).
+//
+//Then one match is run through a Room, as a server worker runs it (Room::update, Room::send), with a client per encoding
+// on the other end of each connection: it takes every snapshot (recv_state_message) and acknowledges it, so the room sends deltas.
+// Past a warm-up, neither the updates nor the snapshot round trips may allocate -- if they do, sim-bench says so and exits with status 1.
+//
+//Matches are seeded (seed + match index), so for the same arguments every build plays the same games --
+// 'state_hash' changing between versions means the simulation itself changed, not just its speed.
+//
+//Links only the headless sources (Game.cpp, Room.cpp, Connection.cpp, ... + AllocationCounter.cpp -- no SDL or GL), so it can run on any box.
+
+#include "Game.hpp"
+#include "Room.hpp"
+#include "Message.hpp"
+#include "RingBuffer.hpp"
+#include "AllocationCounter.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+//------------ bots ------------
+
+//buttons for a paddle: chase the ball while it's coming this way, else drift back to the middle
+// ('deadzone' varies per player, so the matches don't all play the same way):
+static void bot_controls(Game const &game, Player &player, bool is_front, float deadzone) {
+	bool incoming = (is_front ? game.BallDirection.x < 0.0f : game.BallDirection.x > 0.0f);
+	float target = (incoming ? game.BallPosition.y : 0.0f);
+	player.controls.up.pressed = (target > player.position + deadzone);
+	player.controls.down.pressed = (target < player.position - deadzone);
+}
+
+//hand everything 'from' has waiting to send over to 'to', in order, as a socket would:
+// (send_buffer bytes interleaved with the queued shared blocks, the same walk Connection makes when it sends)
+static void deliver(Connection &from, RingBuffer &to) {
+	auto move_buffered = [&](size_t count) {
+		while (count > 0) {
+			std::span< uint8_t const > span = from.send_buffer.read_span(0);
+			span = span.first(std::min(span.size(), count));
+			to.append(span.data(), span.size());
+			from.send_buffer.consume(span.size());
+			count -= span.size();
+		}
+	};
+	while (!from.send_shared_queue.empty()) {
+		Connection::SharedSend &block = from.send_shared_queue.front();
+		assert(block.offset == 0);
+		move_buffered(block.after);
+		to.append(block.header.data(), block.header_size);
+		if (block.bytes) to.append(block.bytes->data(), block.bytes->size());
+		from.send_shared_queue.pop_front();
+	}
+	move_buffered(from.send_buffer.size());
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	try {
+#endif
+	//------------ argument parsing ------------
+
+	auto usage = []() {
+		std::cerr << "Usage:\n\t./sim-bench [matches=2000] [ticks=2000] [seed=17]" << std::endl;
+		return 1;
+	};
+	if (argc > 4) return usage();
+	uint32_t match_count, ticks;
+	uint64_t seed;
+	try {
+		match_count = (argc > 1 ? uint32_t(std::stoul(argv[1])) : 2000);
+		ticks = (argc > 2 ? uint32_t(std::stoul(argv[2])) : 2000);
+		seed = (argc > 3 ? uint64_t(std::stoull(argv[3])) : 17);
+	} catch (std::logic_error const &) { //(std::invalid_argument or std::out_of_range -- e.g., for '--help')
+		return usage();
+	}
+	if (match_count == 0 || ticks == 0) {
+		std::cerr << "Need at least one match and one tick." << std::endl;
+		return 1;
+	}
+
+	//timing every update() would mostly measure the clock, so only one match in this many is timed individually:
+	constexpr uint32_t SampleEvery = 16;
+
+	//------------ setup ------------
+
+	std::vector< Game > matches;
+	matches.reserve(match_count);
+	for (uint32_t i = 0; i < match_count; ++i) {
+		matches.emplace_back(seed + i);
+		matches.back().spawn_player();
+		matches.back().spawn_player();
+	}
+	auto deadzone = [](uint32_t match, uint32_t player) {
+		return 1.0f + float((match * 2 + player) % 7);
+	};
+
+	std::vector< float > sampled_ns;
+	sampled_ns.reserve(size_t((match_count + SampleEvery - 1) / SampleEvery) * ticks);
+
+	//------------ run ------------
+
+	using Clock = std::chrono::steady_clock;
+	std::string failure; //(first thing that went wrong)
+	auto expect_no_allocations = [&](AllocationCounter const &counter, char const *what) {
+		try {
+			counter.expect_none(what);
+		} catch (std::runtime_error const &e) {
+			if (failure.empty()) failure = e.what();
+		}
+	};
+
+	AllocationCounter update_allocations;
+	auto start = Clock::now();
+
+	for (uint32_t t = 0; t < ticks; ++t) {
+		for (uint32_t i = 0; i < match_count; ++i) {
+			Game &game = matches[i];
+			bot_controls(game, game.players.front(), true, deadzone(i, 0));
+			bot_controls(game, game.players.back(), false, deadzone(i, 1));
+			if (i % SampleEvery == 0) {
+				auto before = Clock::now();
+				game.update(Game::Tick);
+				sampled_ns.emplace_back(std::chrono::duration< float, std::nano >(Clock::now() - before).count());
+			} else {
+				game.update(Game::Tick);
+			}
+			//(as the server does after every update)
+			game.sounds_to_play = 0;
+		}
+	}
+
+	double seconds = std::chrono::duration< double >(Clock::now() - start).count();
+	uint64_t run_allocations = update_allocations.allocations();
+	uint64_t run_bytes = update_allocations.bytes();
+	expect_no_allocations(update_allocations, "Game::update()");
+
+	//------------ snapshots ------------
+
+	//(long enough to fill the snapshot history, the payload pool, and the connections' queues)
+	constexpr uint32_t Warmup = 2 * Game::StateHistory;
+
+	//one room with a client per encoding, on connections without sockets -- the bench carries bytes between their ends:
+	static_assert(Game::StateEncodings <= Room::MaxPlayers, "one room holds a client per encoding");
+	Room room;
+	room.game = Game(seed);
+	Connection server_ends[Game::StateEncodings];
+	Connection client_ends[Game::StateEncodings];
+	Game clients[Game::StateEncodings];
+
+	for (uint32_t e = 0; e < Game::StateEncodings; ++e) {
+		Connection *c = &server_ends[e];
+		//(as RoomWorker::add_connection does)
+		room.connection_to_player.emplace(c, room.game.spawn_player());
+		room.connection_to_ack.emplace(c, Game::StateAck());
+		room.connection_to_rtt.emplace(c, 0.0f);
+		room.schedule_sends(c, e);
+		clients[e].state_encoding = StateEncoding(e);
+		clients[e].send_state_ack_message(&client_ends[e]);
+	}
+
+	//the room takes acks (as RoomWorker::run does), the clients take states and rates (as PlayMode does):
+	Connection *from = nullptr; //(whose messages are being dispatched)
+	MessageDispatch room_dispatch;
+	room_dispatch.on(Message::C2S_StateAck, [&](MessageView const &message) {
+		Game::recv_state_ack_message(message, &room.connection_to_ack.at(from));
+		room.update_send_rate(from);
+	});
+	Game *client = nullptr; //(whose messages are being dispatched)
+	MessageDispatch client_dispatch;
+	client_dispatch.on(Message::S2C_State, [&](RingBuffer const &buffer, MessageView const &message) {
+		client->recv_state_message(buffer, message);
+	});
+	client_dispatch.on(Message::S2C_Rates, [&](MessageView const &message) {
+		client->recv_rates_message(message);
+	});
+
+	std::vector< float > snapshot_ns;
+	snapshot_ns.reserve(ticks);
+	uint64_t delta_snapshots = 0;
+	AllocationCounter snapshot_allocations;
+
+	for (uint32_t t = 0; t < Warmup + ticks; ++t) {
+		if (t == Warmup) snapshot_allocations = AllocationCounter();
+		auto before = Clock::now();
+
+		bot_controls(room.game, room.game.players.front(), true, deadzone(0, 0));
+		bot_controls(room.game, room.game.players.back(), false, deadzone(0, 1));
+		room.update();
+		room.send();
+
+		for (uint32_t e = 0; e < Game::StateEncodings; ++e) {
+			//server -> client:
+			deliver(server_ends[e], client_ends[e].recv_buffer);
+			MessageView state;
+			if (t >= Warmup && peek_message(client_ends[e].recv_buffer, Message::S2C_State, &state) && state.read< uint32_t >(6) != 0) {
+				delta_snapshots += 1;
+			}
+			client = &clients[e];
+			client_dispatch.dispatch(&client_ends[e]);
+			if (clients[e].state_seq != room.game.state_seq) {
+				std::cerr << "Client didn't take snapshot " << room.game.state_seq << "." << std::endl;
+				return 1;
+			}
+
+			//client -> server:
+			clients[e].send_state_ack_message(&client_ends[e]);
+			from = &server_ends[e];
+			room_dispatch.dispatch(client_ends[e].send_buffer);
+		}
+
+		if (t >= Warmup) snapshot_ns.emplace_back(std::chrono::duration< float, std::nano >(Clock::now() - before).count());
+	}
+	uint64_t snapshot_allocation_count = snapshot_allocations.allocations();
+	expect_no_allocations(snapshot_allocations, "A room tick with snapshots + client decode and ack");
+
+	if (clients[uint32_t(StateEncoding::Raw)].BallPosition != room.game.BallPosition) {
+		if (failure.empty()) failure = "Client's decoded ball doesn't match the server's.";
+	}
+
+	//------------ results ------------
+
+	double updates = double(match_count) * ticks;
+
+	std::sort(sampled_ns.begin(), sampled_ns.end());
+	std::sort(snapshot_ns.begin(), snapshot_ns.end());
+	auto percentile_of = [](std::vector< float > const &sorted, double p) -> double {
+		return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))];
+	};
+	auto percentile = [&](double p) {
+		return percentile_of(sampled_ns, p);
+	};
+
+	//one checksum for every match's final state (FNV-1a over the per-match hashes):
+	uint64_t state_hash = 0xcbf29ce484222325ull;
+	uint64_t points = 0;
+	for (auto const &game : matches) {
+		uint64_t h = game.hash();
+		for (uint32_t b = 0; b < 8; ++b) {
+			state_hash = (state_hash ^ ((h >> (8 * b)) & 0xff)) * 0x100000001b3ull;
+		}
+		for (auto const &player : game.players) points += player.score;
+	}
+
+	std::cout << std::fixed
+		<< "{\"bench\":\"sim-bench\",\"format\":1"
+		<< ",\"matches\":" << match_count
+		<< ",\"ticks\":" << ticks
+		<< ",\"seed\":" << seed
+		<< ",\"updates\":" << uint64_t(updates)
+		<< ",\"seconds\":" << std::setprecision(6) << seconds
+		<< ",\"updates_per_sec\":" << std::setprecision(0) << updates / seconds
+		<< ",\"ns_per_update\":{\"mean\":" << std::setprecision(2) << 1e9 * seconds / updates
+		<< ",\"p50\":" << percentile(0.5)
+		<< ",\"p90\":" << percentile(0.9)
+		<< ",\"p99\":" << percentile(0.99)
+		<< ",\"p999\":" << percentile(0.999)
+		<< ",\"max\":" << sampled_ns.back()
+		<< ",\"samples\":" << sampled_ns.size() << "}"
+		<< ",\"allocations_per_update\":" << std::setprecision(4) << run_allocations / updates
+		<< ",\"allocated_bytes_per_update\":" << run_bytes / updates
+		<< ",\"points_scored\":" << points
+		<< ",\"snapshot_ticks\":{\"ticks\":" << ticks
+		<< ",\"delta_fraction\":" << std::setprecision(4) << double(delta_snapshots) / (double(ticks) * Game::StateEncodings)
+		<< ",\"ns_p50\":" << std::setprecision(2) << percentile_of(snapshot_ns, 0.5)
+		<< ",\"ns_p99\":" << percentile_of(snapshot_ns, 0.99)
+		<< ",\"ns_max\":" << snapshot_ns.back()
+		<< ",\"allocations\":" << snapshot_allocation_count
+		<< ",\"payload_pool\":" << room.game.payload_pool.size() << "}"
+		<< ",\"allocation_free\":" << (failure.empty() ? "true" : "false")
+		<< ",\"state_hash\":\"" << std::hex << std::setw(16) << std::setfill('0') << state_hash << std::dec << "\""
+		<< "}" << std::endl;
+
+	std::cerr << std::fixed
+		<< "sim-bench: " << match_count << " matches x " << ticks << " ticks: "
+		<< std::setprecision(0) << updates / seconds << " updates/s, "
+		<< std::setprecision(1) << "ns/update p50 " << percentile(0.5) << " p99 " << percentile(0.99) << " max " << sampled_ns.back() << ", "
+		<< std::setprecision(3) << run_allocations / updates << " allocations/update; "
+		<< "room tick + snapshots + decode: p50 " << std::setprecision(1) << percentile_of(snapshot_ns, 0.5) << " ns, "
+		<< snapshot_allocation_count << " allocations after warm-up" << std::endl;
+
+	if (!failure.empty()) {
+		std::cerr << "FAILED: " << failure << std::endl;
+		return 1;
+	}
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}